@@ -0,0 +1,49 @@
+#pragma once
+
+#include "helper.h"
+
+//dimensions that get their own fixed-size instantiation of a kernel: 6 atoms without the fixed symmetry coordinates,
+//with or without the one taken by the sphere. Only there is Eigen's fixed-size LU reliably faster than the dynamic one
+//(modules/fixedDimensionsBenchmark.cpp), while every size adds seconds to the build of linearAlgebraUtils.cpp
+constexpr int MIN_FIXED_DIMS = 11;
+constexpr int MAX_FIXED_DIMS = 13;
+
+template<int N>
+using fixed_vect = Eigen::Matrix<double, N, 1>;
+
+template<int N>
+using fixed_matrix = Eigen::Matrix<double, N, N>;
+
+template<int N>
+using dims_constant = integral_constant<int, N>;
+
+template<int N>
+struct DimensionDispatcher
+{
+    template<typename KernelT>
+    static auto dispatch(size_t nDims, KernelT&& kernel)
+    {
+        if (nDims == (size_t) N)
+            return kernel(dims_constant<N>());
+        return DimensionDispatcher<N + 1>::dispatch(nDims, forward<KernelT>(kernel));
+    }
+};
+
+template<>
+struct DimensionDispatcher<MAX_FIXED_DIMS + 1>
+{
+    template<typename KernelT>
+    static auto dispatch(size_t, KernelT&& kernel)
+    {
+        return kernel(dims_constant<Eigen::Dynamic>());
+    }
+};
+
+//calls kernel(dims_constant<N>()) with N == nDims when nDims is in [MIN_FIXED_DIMS, MAX_FIXED_DIMS] and with
+//N == Eigen::Dynamic otherwise, so that the kernel can work with fixed_vect<N> and fixed_matrix<N>: they live on the
+//stack and their loops have compile-time bounds. All instantiations must return the same type
+template<typename KernelT>
+auto dispatchDimension(size_t nDims, KernelT&& kernel)
+{
+    return DimensionDispatcher<MIN_FIXED_DIMS>::dispatch(nDims, forward<KernelT>(kernel));
+}
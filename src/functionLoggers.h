@@ -2,7 +2,7 @@
 
 #include "helper.h"
 
-#include "producers/InPolar.h"
+#include "producers/OnSphere.h"
 #include "linearAlgebraUtils.h"
 
 template<typename FuncT>
@@ -20,9 +20,9 @@ void logFunctionInfo(FuncT&& func, vect const& p, string const& title = "")
 template<typename FuncT>
 void logFunctionPolarInfo(FuncT&& func, vect const& p, double r, string const& title = "")
 {
-    auto polar = makePolarWithDirection(func, r, p);
+    auto onSphere = makeOnSphere(func, r, p);
 
-    auto valueGradHess = polar.valueGradHess(makeConstantVect(polar.nDims, M_PI / 2));
+    auto valueGradHess = onSphere.valueGradHess(makeConstantVect(onSphere.nDims, 0.));
     auto value = get<0>(valueGradHess);
     auto grad = get<1>(valueGradHess);
     auto hess = get<2>(valueGradHess);
@@ -0,0 +1,184 @@
+#include "BackendUsage.h"
+
+#include <cstdio>
+
+namespace
+{
+    thread_local string currentStage = "unstaged";
+
+    string quoted(string const& text)
+    {
+        string result = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "\"";
+    }
+}
+
+UsageStage::UsageStage(string name) : mPrevious(move(currentStage))
+{
+    currentStage = move(name);
+}
+
+UsageStage::~UsageStage()
+{
+    currentStage = move(mPrevious);
+}
+
+string const& UsageStage::current()
+{
+    return currentStage;
+}
+
+BackendUsage::BackendUsage() : mDumpPeriod(0), mDumpStopped(true)
+{ }
+
+BackendUsage::~BackendUsage()
+{
+    stopPeriodicDump();
+}
+
+void BackendUsage::recordJob(string const& stage, string const& method, double wallSeconds, double cpuSeconds)
+{
+    size_t bucket = 0;
+    for (double bound = FIRST_BUCKET_SECONDS; bucket + 1 < HISTOGRAM_BUCKETS && wallSeconds >= bound; bound *= 2)
+        bucket++;
+
+    lock_guard<mutex> lock(mMutex);
+    auto& s = stat(stage, method);
+    s.jobs++;
+    s.wallSeconds += wallSeconds;
+    s.cpuSeconds += cpuSeconds;
+    s.maxWallSeconds = max(s.maxWallSeconds, wallSeconds);
+    s.histogram[bucket]++;
+}
+
+void BackendUsage::recordFailure(string const& stage, string const& method)
+{
+    lock_guard<mutex> lock(mMutex);
+    stat(stage, method).failures++;
+}
+
+void BackendUsage::recordCacheHit(string const& stage, string const& method)
+{
+    lock_guard<mutex> lock(mMutex);
+    stat(stage, method).cacheHits++;
+}
+
+void BackendUsage::recordStoreHit(string const& stage, string const& method)
+{
+    lock_guard<mutex> lock(mMutex);
+    stat(stage, method).storeHits++;
+}
+
+BackendUsage::Stat BackendUsage::get(string const& stage, string const& method) const
+{
+    lock_guard<mutex> lock(mMutex);
+    auto it = mStats.find(stage);
+    if (it == mStats.end())
+        return Stat();
+    auto jt = it->second.find(method);
+    return jt == it->second.end() ? Stat() : jt->second;
+}
+
+string BackendUsage::toJson() const
+{
+    string bounds;
+    for (size_t i = 0; i + 1 < HISTOGRAM_BUCKETS; i++)
+        bounds += format("{}{}", i ? ", " : "", FIRST_BUCKET_SECONDS * (1 << i));
+
+    lock_guard<mutex> lock(mMutex);
+
+    string stages;
+    for (auto const& stage : mStats) {
+        string methods;
+        for (auto const& method : stage.second) {
+            auto const& s = method.second;
+
+            string histogram;
+            for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+                histogram += format("{}{}", i ? ", " : "", s.histogram[i]);
+
+            methods += format("{}\n      {}: {{\"jobs\": {}, \"failures\": {}, \"cacheHits\": {}, \"storeHits\": {}, "
+                              "\"wallSeconds\": {:.3f}, \"cpuSeconds\": {:.3f}, \"maxWallSeconds\": {:.3f}, "
+                              "\"histogram\": [{}]}}", methods.empty() ? "" : ",", quoted(method.first), s.jobs,
+                              s.failures, s.cacheHits, s.storeHits, s.wallSeconds, s.cpuSeconds, s.maxWallSeconds,
+                              histogram);
+        }
+        stages += format("{}\n    {}: {{{}\n    }}", stages.empty() ? "" : ",", quoted(stage.first), methods);
+    }
+
+    return format("{{\n  \"histogramUpperBoundsSeconds\": [{}],\n  \"stages\": {{{}\n  }}\n}}\n", bounds, stages);
+}
+
+//written next to the target and renamed over it, so readers never see a partial file
+void BackendUsage::dump(string const& path) const
+{
+    auto json = toJson();
+    auto tmpPath = path + ".tmp";
+    {
+        ofstream output(tmpPath);
+        output << json;
+        if (!output)
+            throw runtime_error(format("failed to write backend usage to {}", tmpPath));
+    }
+    if (rename(tmpPath.c_str(), path.c_str()))
+        throw runtime_error(format("failed to move backend usage to {}: {}", path, strerror(errno)));
+}
+
+void BackendUsage::startPeriodicDump(string path, double period)
+{
+    stopPeriodicDump();
+
+    lock_guard<mutex> lock(mMutex);
+    mDumpPath = move(path);
+    mDumpPeriod = period;
+    mDumpStopped = false;
+    mDumper = thread([this] { dumpPeriodically(); });
+}
+
+void BackendUsage::stopPeriodicDump()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mDumpStopped = true;
+    }
+    mDumpCondition.notify_all();
+    if (mDumper.joinable())
+        mDumper.join();
+}
+
+shared_ptr<BackendUsage> const& BackendUsage::global()
+{
+    static auto const usage = make_shared<BackendUsage>();
+    return usage;
+}
+
+BackendUsage::Stat& BackendUsage::stat(string const& stage, string const& method)
+{
+    return mStats[stage][method];
+}
+
+void BackendUsage::dumpPeriodically()
+{
+    unique_lock<mutex> lock(mMutex);
+    while (true) {
+        bool stopped = mDumpCondition.wait_for(lock, chrono::duration<double>(mDumpPeriod),
+                                               [this] { return mDumpStopped; });
+        auto path = mDumpPath;
+
+        lock.unlock();
+        try {
+            dump(path);
+        } catch (runtime_error const& exc) {
+            LOG_ERROR("{}", exc.what());
+        }
+        lock.lock();
+
+        if (stopped)
+            return;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "helper.h"
+
+#include <map>
+#include <mutex>
+#include <array>
+#include <condition_variable>
+
+//workflow stage that QM work is charged to. Stages nest per thread and the innermost one wins; jobs handed to the
+//job pool carry the stage of the thread that submitted them
+class UsageStage
+{
+public:
+    explicit UsageStage(string name);
+    ~UsageStage();
+
+    UsageStage(UsageStage const&) = delete;
+    UsageStage& operator=(UsageStage const&) = delete;
+
+    static string const& current();
+
+private:
+    string mPrevious;
+};
+
+//counts of QM jobs, cache and result store hits, wall and CPU seconds and wall time histograms, keyed by stage and
+//method. Can be dumped as JSON at any moment and periodically from a background thread
+class BackendUsage
+{
+public:
+    static constexpr size_t HISTOGRAM_BUCKETS = 20;
+    static constexpr double FIRST_BUCKET_SECONDS = .25;
+
+    struct Stat
+    {
+        size_t jobs = 0;
+        size_t failures = 0;
+        size_t cacheHits = 0;
+        size_t storeHits = 0;
+        double wallSeconds = 0;
+        double cpuSeconds = 0;
+        double maxWallSeconds = 0;
+        //bucket i counts jobs faster than FIRST_BUCKET_SECONDS * 2^i, the last one all slower jobs
+        array<size_t, HISTOGRAM_BUCKETS> histogram{};
+    };
+
+    BackendUsage();
+    ~BackendUsage();
+
+    BackendUsage(BackendUsage const&) = delete;
+    BackendUsage& operator=(BackendUsage const&) = delete;
+
+    void recordJob(string const& stage, string const& method, double wallSeconds, double cpuSeconds);
+    void recordFailure(string const& stage, string const& method);
+    void recordCacheHit(string const& stage, string const& method);
+    void recordStoreHit(string const& stage, string const& method);
+
+    Stat get(string const& stage, string const& method) const;
+    string toJson() const;
+    void dump(string const& path) const;
+
+    //rewrites path every period seconds until stopped or destroyed, then writes it one last time
+    void startPeriodicDump(string path, double period);
+    void stopPeriodicDump();
+
+    static shared_ptr<BackendUsage> const& global();
+
+private:
+    mutable mutex mMutex;
+    map<string, map<string, Stat>> mStats;
+
+    string mDumpPath;
+    double mDumpPeriod;
+    bool mDumpStopped;
+    condition_variable mDumpCondition;
+    thread mDumper;
+
+    Stat& stat(string const& stage, string const& method);
+    void dumpPeriodically();
+};
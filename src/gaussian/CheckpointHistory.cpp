@@ -0,0 +1,91 @@
+#include "CheckpointHistory.h"
+
+#include <unistd.h>
+
+CheckpointHistory::Checkpoint::Checkpoint(vect structure, string path) : mStructure(move(structure)),
+                                                                         mPath(move(path))
+{ }
+
+CheckpointHistory::Checkpoint::~Checkpoint()
+{
+    ::unlink(mPath.c_str());
+}
+
+vect const& CheckpointHistory::Checkpoint::getStructure() const
+{
+    return mStructure;
+}
+
+string const& CheckpointHistory::Checkpoint::getPath() const
+{
+    return mPath;
+}
+
+bool CheckpointHistory::Checkpoint::copyTo(string const& path) const
+{
+    ifstream from(mPath, ios::binary);
+    ofstream to(path, ios::binary | ios::trunc);
+    to << from.rdbuf();
+
+    return from && to;
+}
+
+CheckpointHistory::CheckpointHistory(ScratchManager::Lease directory, size_t capacity, double maxDistance)
+        : mDirectory(move(directory)), mCapacity(capacity), mMaxDistance(maxDistance), mLastId(0), mWarmStarts(0)
+{ }
+
+shared_ptr<CheckpointHistory::Checkpoint const> CheckpointHistory::nearest(vect const& structure)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    shared_ptr<Checkpoint const> result;
+    double minDistance = mMaxDistance;
+    for (auto const& checkpoint : mCheckpoints) {
+        if (checkpoint->getStructure().rows() != structure.rows())
+            continue;
+
+        double distance = (checkpoint->getStructure() - structure).norm();
+        if (distance <= minDistance) {
+            minDistance = distance;
+            result = checkpoint;
+        }
+    }
+
+    if (result)
+        mWarmStarts++;
+    return result;
+}
+
+void CheckpointHistory::add(vect const& structure, string const& chkPath)
+{
+    unique_lock<mutex> lock(mMutex);
+    auto path = format("{}{}.chk", mDirectory.getPath(), ++mLastId);
+    lock.unlock();
+
+    if (::link(chkPath.c_str(), path.c_str())) {
+        ifstream from(chkPath, ios::binary);
+        if (!from) {
+            LOG_WARN("checkpoint {} is missing, not retained", chkPath);
+            return;
+        }
+        ofstream(path, ios::binary) << from.rdbuf();
+    }
+
+    auto checkpoint = make_shared<Checkpoint const>(structure, path);
+
+    lock.lock();
+    mCheckpoints.push_back(move(checkpoint));
+    if (mCheckpoints.size() > mCapacity)
+        mCheckpoints.pop_front();
+}
+
+size_t CheckpointHistory::size()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mCheckpoints.size();
+}
+
+size_t CheckpointHistory::getWarmStarts() const
+{
+    return mWarmStarts;
+}
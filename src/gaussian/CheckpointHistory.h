@@ -0,0 +1,51 @@
+#pragma once
+
+#include "helper.h"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+#include "ScratchManager.h"
+
+//retains checkpoints of recently converged jobs so that a new job can read its initial SCF guess from the
+//geometrically nearest one. A checkpoint file lives while it is either in the history or being copied by a job.
+class CheckpointHistory
+{
+public:
+    class Checkpoint
+    {
+    public:
+        Checkpoint(vect structure, string path);
+        ~Checkpoint();
+
+        Checkpoint(Checkpoint const&) = delete;
+        Checkpoint& operator=(Checkpoint const&) = delete;
+
+        vect const& getStructure() const;
+        string const& getPath() const;
+        bool copyTo(string const& path) const;
+
+    private:
+        vect const mStructure;
+        string const mPath;
+    };
+
+    explicit CheckpointHistory(ScratchManager::Lease directory, size_t capacity = 16, double maxDistance = 1.);
+
+    shared_ptr<Checkpoint const> nearest(vect const& structure);
+    void add(vect const& structure, string const& chkPath);
+
+    size_t size();
+    size_t getWarmStarts() const;
+
+private:
+    ScratchManager::Lease mDirectory;
+    size_t const mCapacity;
+    double const mMaxDistance;
+
+    mutex mMutex;
+    deque<shared_ptr<Checkpoint const>> mCheckpoints;
+    size_t mLastId;
+    atomic<size_t> mWarmStarts;
+};
@@ -0,0 +1,83 @@
+#include "EvaluationCache.h"
+
+EvaluationCache::EvaluationCache(size_t capacity) : mCapacity(capacity), mLastId(0), mHits(0), mMisses(0), mCoalesced(0)
+{ }
+
+optional<GaussianResult> EvaluationCache::find(vect const& x, size_t order)
+{
+    shared_future<GaussianResult> result;
+    {
+        lock_guard<mutex> lock(mMutex);
+
+        auto it = mEntries.find(makeKey(x));
+        if (it == mEntries.end() || it->second.order < order || !isReady(it->second.result))
+            return boost::none;
+        result = it->second.result;
+    }
+
+    try {
+        auto found = result.get();
+        mHits++;
+        return found;
+    } catch (...) {
+        return boost::none;
+    }
+}
+
+void EvaluationCache::clear()
+{
+    lock_guard<mutex> lock(mMutex);
+    mEntries.clear();
+    mInsertionOrder.clear();
+}
+
+size_t EvaluationCache::hits() const
+{
+    return mHits;
+}
+
+size_t EvaluationCache::misses() const
+{
+    return mMisses;
+}
+
+size_t EvaluationCache::coalesced() const
+{
+    return mCoalesced;
+}
+
+EvaluationCache::Key EvaluationCache::makeKey(vect const& x)
+{
+    Key key((size_t) x.size());
+    for (size_t i = 0; i < key.size(); i++)
+        key[i] = llround(x(i) / GEOMETRY_QUANTUM);
+    return key;
+}
+
+bool EvaluationCache::isReady(shared_future<GaussianResult> const& result)
+{
+    return result.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+void EvaluationCache::insert(Key const& key, Entry entry)
+{
+    if (mEntries.count(key) == 0)
+        mInsertionOrder.push_back(key);
+    mEntries[key] = move(entry);
+
+    while (mEntries.size() > mCapacity) {
+        mEntries.erase(mInsertionOrder.front());
+        mInsertionOrder.pop_front();
+    }
+}
+
+void EvaluationCache::erase(Key const& key, size_t id)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    auto it = mEntries.find(key);
+    if (it != mEntries.end() && it->second.id == id) {
+        mEntries.erase(it);
+        mInsertionOrder.erase(std::find(mInsertionOrder.begin(), mInsertionOrder.end(), key));
+    }
+}
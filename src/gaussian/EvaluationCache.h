@@ -0,0 +1,98 @@
+#pragma once
+
+#include "helper.h"
+
+#include <map>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <deque>
+
+#include "GaussianResult.h"
+
+//thread-safe memo of QM evaluations keyed on quantized geometry. An entry of some derivative order also answers
+//queries of any lesser order (freq > force > scf). Concurrent requests for the same geometry wait for the job
+//that is already in flight instead of launching their own.
+class EvaluationCache
+{
+public:
+    static constexpr double GEOMETRY_QUANTUM = 1e-10;
+
+    explicit EvaluationCache(size_t capacity = 4096);
+
+    template<typename ComputeT>
+    GaussianResult get(vect const& x, size_t order, ComputeT&& compute)
+    {
+        auto key = makeKey(x);
+
+        promise<GaussianResult> computed;
+        shared_future<GaussianResult> result;
+        size_t id = 0;
+        bool owner = false;
+        {
+            lock_guard<mutex> lock(mMutex);
+
+            auto it = mEntries.find(key);
+            if (it != mEntries.end() && it->second.order >= order) {
+                if (isReady(it->second.result))
+                    mHits++;
+                else
+                    mCoalesced++;
+                result = it->second.result;
+            } else {
+                mMisses++;
+                owner = true;
+                id = ++mLastId;
+                result = computed.get_future().share();
+                insert(key, Entry{order, id, result});
+            }
+        }
+
+        if (owner) {
+            try {
+                computed.set_value(compute());
+            } catch (...) {
+                computed.set_exception(current_exception());
+                erase(key, id);
+            }
+        }
+
+        return result.get();
+    }
+
+    //finished entry of at least the given order, if there is one
+    optional<GaussianResult> find(vect const& x, size_t order);
+
+    void clear();
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t coalesced() const;
+
+private:
+    using Key = vector<long long>;
+
+    struct Entry
+    {
+        size_t order;
+        size_t id;
+        shared_future<GaussianResult> result;
+    };
+
+    size_t const mCapacity;
+
+    mutex mMutex;
+    map<Key, Entry> mEntries;
+    deque<Key> mInsertionOrder;
+    size_t mLastId;
+
+    atomic<size_t> mHits;
+    atomic<size_t> mMisses;
+    atomic<size_t> mCoalesced;
+
+    static Key makeKey(vect const& x);
+    static bool isReady(shared_future<GaussianResult> const& result);
+
+    void insert(Key const& key, Entry entry);
+    void erase(Key const& key, size_t id);
+};
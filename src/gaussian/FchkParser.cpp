@@ -0,0 +1,249 @@
+#include "FchkParser.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+
+namespace
+{
+    double const POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                    1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    char const ENERGY_SECTION[] = "Total Energy";
+    char const GRADIENT_SECTION[] = "Cartesian Gradient";
+    char const HESSIAN_SECTION[] = "Cartesian Force Constants";
+    char const STRUCTURE_SECTION[] = "Current cartesian coordinates";
+
+    template<size_t N>
+    bool startsWith(char const* p, char const* end, char const (&prefix)[N])
+    {
+        return (size_t) (end - p) >= N - 1 && !memcmp(p, prefix, N - 1);
+    }
+
+    char const* nextLine(char const* p, char const* end)
+    {
+        auto newLine = (char const*) memchr(p, '\n', end - p);
+        return newLine ? newLine + 1 : end;
+    }
+
+    size_t parseArraySize(char const* p, char const* end)
+    {
+        auto lineEnd = nextLine(p, end);
+        for (; p + 1 < lineEnd; p++)
+            if (p[0] == 'N' && p[1] == '=')
+                return (size_t) strtol(p + 2, nullptr, 10);
+        throw runtime_error("fchk array section without size");
+    }
+
+    //reads `size` reals after the section header line at p, passing each one to consume(index, value)
+    template<typename ConsumerT>
+    char const* parseArray(char const* p, char const* end, size_t expected, ConsumerT&& consume)
+    {
+        if (parseArraySize(p, end) != expected)
+            throw runtime_error(format("fchk array of unexpected size (expected {})", expected));
+
+        p = nextLine(p, end);
+        for (size_t i = 0; i < expected; i++)
+            consume(i, parseFortranDouble(p, end));
+        return p;
+    }
+}
+
+MappedFile::MappedFile(string const& path) : mData(nullptr), mSize(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error(format("can not open {}: {}", path, strerror(errno)));
+
+    struct stat st;
+    if (!fstat(fd, &st) && st.st_size > 0) {
+        void* data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            mData = (char const*) data;
+            mSize = (size_t) st.st_size;
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData)
+        munmap((void*) mData, mSize);
+}
+
+char const* MappedFile::begin() const
+{
+    return mData;
+}
+
+char const* MappedFile::end() const
+{
+    return mData + mSize;
+}
+
+double parseFortranDouble(char const*& p, char const* end)
+{
+    while (p != end && isspace((unsigned char) *p))
+        p++;
+
+    char const* start = p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+
+    for (; p != end && isdigit((unsigned char) *p); p++, digits++)
+        mantissa = mantissa * 10 + (*p - '0');
+    if (p != end && *p == '.')
+        for (p++; p != end && isdigit((unsigned char) *p); p++, digits++, exponent--)
+            mantissa = mantissa * 10 + (*p - '0');
+
+    if (!digits)
+        throw runtime_error("fchk real expected");
+
+    if (p != end && (*p == 'E' || *p == 'e' || *p == 'D' || *p == 'd')) {
+        p++;
+        bool negativeExponent = false;
+        if (p != end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+
+        int value = 0;
+        for (; p != end && isdigit((unsigned char) *p); p++)
+            value = value * 10 + (*p - '0');
+        exponent += negativeExponent ? -value : value;
+    }
+
+    //exact while the mantissa and the power of ten are both exactly representable
+    if (digits <= 19 && mantissa < (1ull << 53) && abs(exponent) <= 22) {
+        double value = (double) mantissa;
+        value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+        return negative ? -value : value;
+    }
+
+    string copy(start, p);
+    replace(copy.begin(), copy.end(), 'D', 'E');
+    replace(copy.begin(), copy.end(), 'd', 'E');
+    return strtod(copy.c_str(), nullptr);
+}
+
+GaussianResult parseFchk(string const& path, size_t nDims, size_t order, double lengthFactor)
+{
+    MappedFile file(path);
+    auto p = file.begin();
+    auto end = file.end();
+
+    GaussianResult result;
+    bool hasValue = false;
+    if (order >= 1)
+        result.grad = vect(nDims);
+    if (order >= 2)
+        result.hess = matrix(nDims, nDims);
+
+    bool needGrad = order >= 1;
+    bool needHess = order >= 2;
+
+    while (p != end && (!hasValue || needGrad || needHess)) {
+        if (*p == ' ') {
+            p = nextLine(p, end);
+        } else if (!hasValue && startsWith(p, end, ENERGY_SECTION)) {
+            auto valueStart = min(p + 44, end);
+            result.value = parseFortranDouble(valueStart, end);
+            hasValue = true;
+            p = nextLine(valueStart, end);
+        } else if (needGrad && startsWith(p, end, GRADIENT_SECTION)) {
+            auto& grad = *result.grad;
+            p = parseArray(p, end, nDims, [&](size_t i, double value) {
+                grad(i) = value * lengthFactor;
+            });
+            needGrad = false;
+        } else if (needHess && startsWith(p, end, HESSIAN_SECTION)) {
+            auto& hess = *result.hess;
+            double const factor = sqr(lengthFactor);
+            size_t row = 0, col = 0;
+            p = parseArray(p, end, nDims * (nDims + 1) / 2, [&](size_t, double value) {
+                hess(row, col) = hess(col, row) = value * factor;
+                if (++col > row)
+                    row++, col = 0;
+            });
+            needHess = false;
+        } else {
+            p = nextLine(p, end);
+        }
+    }
+
+    if (!hasValue || needGrad || needHess)
+        throw runtime_error(format("fchk {} misses required sections", path));
+
+    return result;
+}
+
+vect parseFchkStructure(string const& path, size_t nDims, double lengthFactor)
+{
+    MappedFile file(path);
+    auto p = file.begin();
+    auto end = file.end();
+
+    for (; p != end; p = nextLine(p, end))
+        if (startsWith(p, end, STRUCTURE_SECTION)) {
+            vect structure(nDims);
+            parseArray(p, end, nDims, [&](size_t i, double value) {
+                structure(i) = value / lengthFactor;
+            });
+            return structure;
+        }
+
+    throw runtime_error(format("fchk {} has no structure", path));
+}
+
+void writeFchk(ostream& output, string const& title, vector<size_t> const& charges, vect const& structure,
+               GaussianResult const& result)
+{
+    auto writeArrayHeader = [&](char const* name, char type, size_t size) {
+        output << format("{:<40}   {}   N={:12d}\n", name, type, size);
+    };
+    auto writeReals = [&](vector<double> const& values) {
+        for (size_t i = 0; i < values.size(); i++)
+            output << format("{:16.8E}", values[i]) << (i % 5 == 4 || i + 1 == values.size() ? "\n" : "");
+    };
+
+    output << format("{:<72}\n", title);
+    output << format("{:<10}{:<30}{:<30}\n", "SP", "RB3LYP", "3-21G");
+    output << format("{:<40}   I     {:12d}\n", "Number of atoms", charges.size());
+    output << format("{:<40}   I     {:12d}\n", "Charge", 0);
+    output << format("{:<40}   I     {:12d}\n", "Multiplicity", 1);
+
+    writeArrayHeader("Atomic numbers", 'I', charges.size());
+    for (size_t i = 0; i < charges.size(); i++)
+        output << format("{:12d}", charges[i]) << (i % 6 == 5 || i + 1 == charges.size() ? "\n" : "");
+
+    writeArrayHeader("Nuclear charges", 'R', charges.size());
+    writeReals(vector<double>(charges.begin(), charges.end()));
+
+    writeArrayHeader(STRUCTURE_SECTION, 'R', (size_t) structure.size());
+    writeReals(vector<double>(structure.data(), structure.data() + structure.size()));
+
+    output << format("{:<40}   R     {:22.15E}\n", ENERGY_SECTION, result.value);
+
+    if (result.grad) {
+        auto const& grad = *result.grad;
+        writeArrayHeader(GRADIENT_SECTION, 'R', (size_t) grad.size());
+        writeReals(vector<double>(grad.data(), grad.data() + grad.size()));
+    }
+
+    if (result.hess) {
+        auto const& hess = *result.hess;
+        vector<double> lower;
+        for (size_t i = 0; i < (size_t) hess.rows(); i++)
+            for (size_t j = 0; j <= i; j++)
+                lower.push_back(hess(i, j));
+
+        writeArrayHeader(HESSIAN_SECTION, 'R', lower.size());
+        writeReals(lower);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "helper.h"
+
+#include "GaussianResult.h"
+
+//read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(string const& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    char const* begin() const;
+    char const* end() const;
+
+private:
+    char const* mData;
+    size_t mSize;
+};
+
+//parses a Fortran-style real ("-7.853959394560658E+01", D exponents too) and advances the pointer past it
+double parseFortranDouble(char const*& p, char const* end);
+
+//single pass over a formatted checkpoint: locates all needed sections and decodes them straight into the result.
+//Gradient and Hessian are multiplied by lengthFactor and lengthFactor^2 respectively (Bohr -> Angstrom)
+GaussianResult parseFchk(string const& path, size_t nDims, size_t order, double lengthFactor);
+vect parseFchkStructure(string const& path, size_t nDims, double lengthFactor);
+
+//writes a formatted checkpoint in Gaussian's layout. All values are in atomic units
+void writeFchk(ostream& output, string const& title, vector<size_t> const& charges, vect const& structure,
+               GaussianResult const& result);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "helper.h"
+
+struct GaussianResult
+{
+    double value;
+    optional<vect> grad;
+    optional<matrix> hess;
+};
@@ -0,0 +1,93 @@
+#include "HessianHistory.h"
+
+#include "optimization/delta_strategies/QuasiNewtonDeltaStrategy.h"
+
+namespace
+{
+    thread_local bool reuseEnabled = false;
+}
+
+HessianReuseScope::HessianReuseScope(bool enabled) : mPrevious(reuseEnabled)
+{
+    reuseEnabled = enabled;
+}
+
+HessianReuseScope::~HessianReuseScope()
+{
+    reuseEnabled = mPrevious;
+}
+
+bool HessianReuseScope::enabled()
+{
+    return reuseEnabled;
+}
+
+HessianHistory::HessianHistory(Update update, double maxDistance, double tolerance, size_t maxUpdates,
+                               size_t capacity)
+        : mUpdate(update), mMaxDistance(maxDistance), mTolerance(tolerance), mMaxUpdates(maxUpdates),
+          mCapacity(capacity), mExactHessians(0), mUpdatedHessians(0)
+{ }
+
+optional<HessianHistory::Entry> HessianHistory::nearest(vect const& x)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    optional<Entry> result;
+    double minDistance = mMaxDistance;
+    for (auto const& entry : mEntries) {
+        if (entry.x.rows() != x.rows())
+            continue;
+
+        double distance = (entry.x - x).norm();
+        if (distance <= minDistance) {
+            minDistance = distance;
+            result = entry;
+        }
+    }
+
+    return result;
+}
+
+optional<matrix> HessianHistory::update(Entry const& base, vect const& x, vect const& grad) const
+{
+    vect dx = x - base.x;
+    vect dy = grad - base.grad;
+    if (dx.norm() == 0)
+        return base.hess;
+
+    if (base.updates >= mMaxUpdates)
+        return boost::none;
+    if ((dy - base.hess * dx).norm() > mTolerance * dy.norm())
+        return boost::none;
+
+    matrix hess = base.hess;
+    if (mUpdate == Update::Bofill)
+        optimization::Bofill().update(hess, dx, dy);
+    else
+        optimization::BFGS().update(hess, dx, dy);
+
+    return make_optional<matrix>(.5 * (hess + hess.transpose()));
+}
+
+void HessianHistory::add(Entry entry)
+{
+    if (entry.updates)
+        mUpdatedHessians++;
+    else
+        mExactHessians++;
+
+    lock_guard<mutex> lock(mMutex);
+    mEntries.push_back(move(entry));
+    if (mEntries.size() > mCapacity)
+        mEntries.pop_front();
+}
+
+size_t HessianHistory::getExactHessians() const
+{
+    return mExactHessians;
+}
+
+size_t HessianHistory::getUpdatedHessians() const
+{
+    return mUpdatedHessians;
+}
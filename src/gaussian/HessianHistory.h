@@ -0,0 +1,69 @@
+#pragma once
+
+#include "helper.h"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+//marks the code that may take approximate Hessians from a HessianHistory: the second-order loops, where a Hessian
+//only shapes the next step. Everywhere else producers compute exact Hessians even when they keep a history, as
+//normal coordinates and saddle point checks need them. Scopes nest per thread like UsageStage, and jobs handed to
+//the job pool carry the setting of the thread that submitted them
+class HessianReuseScope
+{
+public:
+    explicit HessianReuseScope(bool enabled = true);
+    ~HessianReuseScope();
+
+    HessianReuseScope(HessianReuseScope const&) = delete;
+    HessianReuseScope& operator=(HessianReuseScope const&) = delete;
+
+    static bool enabled();
+
+private:
+    bool mPrevious;
+};
+
+//recent Hessians of a molecule, exact or obtained by quasi-Newton updates. A Hessian near a previous one is
+//updated from the gradient alone as long as the previous Hessian predicts the gradient change well enough and
+//the chain of updates is short; otherwise the caller has to take an exact Hessian.
+class HessianHistory
+{
+public:
+    enum class Update
+    {
+        Bofill, BFGS
+    };
+
+    struct Entry
+    {
+        vect x;
+        vect grad;
+        matrix hess;
+        size_t updates;
+    };
+
+    explicit HessianHistory(Update update = Update::Bofill, double maxDistance = .3, double tolerance = .5,
+                            size_t maxUpdates = 10, size_t capacity = 8);
+
+    optional<Entry> nearest(vect const& x);
+    optional<matrix> update(Entry const& base, vect const& x, vect const& grad) const;
+    void add(Entry entry);
+
+    size_t getExactHessians() const;
+    size_t getUpdatedHessians() const;
+
+private:
+    Update const mUpdate;
+    double const mMaxDistance;
+    double const mTolerance;
+    size_t const mMaxUpdates;
+    size_t const mCapacity;
+
+    mutex mMutex;
+    deque<Entry> mEntries;
+
+    atomic<size_t> mExactHessians;
+    atomic<size_t> mUpdatedHessians;
+};
@@ -0,0 +1,113 @@
+#include "JobPool.h"
+
+namespace
+{
+    thread_local JobPool const* currentPool = nullptr;
+    thread_local size_t heldCores = 0;
+}
+
+JobPool::JobPool(size_t cores, size_t workers) : mCores(max(cores, (size_t) 1)), mBusyCores(0), mStopped(false)
+{
+    if (!workers)
+        workers = mCores;
+    for (size_t i = 0; i < workers; i++)
+        mWorkers.emplace_back([this] { work(); });
+}
+
+JobPool::~JobPool()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+        worker.join();
+}
+
+size_t JobPool::getCores() const
+{
+    return mCores;
+}
+
+size_t JobPool::getBusyCores()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mBusyCores;
+}
+
+size_t JobPool::getPendingJobs()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mJobs.size();
+}
+
+shared_ptr<JobPool> const& JobPool::global()
+{
+    static auto const pool = make_shared<JobPool>(max(thread::hardware_concurrency(), 1u));
+    return pool;
+}
+
+void JobPool::enqueue(size_t cores, function<void()> run)
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mJobs.push_back(Job{min(max(cores, (size_t) 1), mCores), move(run)});
+    }
+    mCondition.notify_all();
+}
+
+void JobPool::work()
+{
+    currentPool = this;
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(mMutex);
+            mCondition.wait(lock, [this] {
+                return mStopped || (!mJobs.empty() && mBusyCores + mJobs.front().cores <= mCores);
+            });
+
+            if (mJobs.empty() || mBusyCores + mJobs.front().cores > mCores)
+                return;
+
+            job = move(mJobs.front());
+            mJobs.pop_front();
+            mBusyCores += job.cores;
+        }
+
+        heldCores = job.cores;
+        job.run();
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            mBusyCores -= job.cores;
+        }
+        mCondition.notify_all();
+    }
+}
+
+bool JobPool::runPending()
+{
+    if (currentPool != this)
+        return false;
+
+    Job job;
+    {
+        lock_guard<mutex> lock(mMutex);
+        auto it = find_if(mJobs.begin(), mJobs.end(), [](Job const& pending) { return pending.cores <= heldCores; });
+        if (it == mJobs.end())
+            return false;
+
+        job = move(*it);
+        mJobs.erase(it);
+    }
+
+    size_t cores = heldCores;
+    heldCores = job.cores;
+    job.run();
+    heldCores = cores;
+
+    return true;
+}
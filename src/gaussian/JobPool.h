@@ -0,0 +1,71 @@
+#pragma once
+
+#include "helper.h"
+
+#include <mutex>
+#include <future>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+
+//runs QM jobs on a fixed set of worker threads while keeping the sum of cores requested by running jobs within
+//a global budget. Jobs are started in submission order; a job that asks for more cores than the whole budget is
+//clamped to it.
+class JobPool
+{
+public:
+    explicit JobPool(size_t cores, size_t workers = 0);
+    ~JobPool();
+
+    JobPool(JobPool const&) = delete;
+    JobPool& operator=(JobPool const&) = delete;
+
+    template<typename FuncT>
+    auto submit(size_t cores, FuncT&& func)
+    {
+        using ResultT = decltype(func());
+
+        auto task = make_shared<packaged_task<ResultT()>>(forward<FuncT>(func));
+        auto result = task->get_future();
+        enqueue(cores, [task] { (*task)(); });
+
+        return result;
+    }
+
+    //waits for a job of this pool. A worker of the pool meanwhile runs pending jobs that fit into the cores its own
+    //job holds, so jobs that fan out into subjobs and wait for them cannot starve the pool
+    template<typename T>
+    T await(future<T>& result)
+    {
+        while (result.wait_for(chrono::seconds(0)) != future_status::ready)
+            if (!runPending())
+                result.wait_for(chrono::milliseconds(1));
+        return result.get();
+    }
+
+    size_t getCores() const;
+    size_t getBusyCores();
+    size_t getPendingJobs();
+
+    static shared_ptr<JobPool> const& global();
+
+private:
+    struct Job
+    {
+        size_t cores;
+        function<void()> run;
+    };
+
+    size_t const mCores;
+    size_t mBusyCores;
+    bool mStopped;
+
+    mutex mMutex;
+    condition_variable mCondition;
+    deque<Job> mJobs;
+    vector<thread> mWorkers;
+
+    void enqueue(size_t cores, function<void()> run);
+    void work();
+    bool runPending();
+};
@@ -0,0 +1,25 @@
+#include "JobTimings.h"
+
+void JobTimings::record(string const& method, size_t nProc, double seconds)
+{
+    lock_guard<mutex> lock(mMutex);
+    auto& stat = mStats[make_pair(method, nProc)];
+    stat.count++;
+    stat.total += seconds;
+}
+
+optional<double> JobTimings::mean(string const& method, size_t nProc) const
+{
+    lock_guard<mutex> lock(mMutex);
+    auto it = mStats.find(make_pair(method, nProc));
+    if (it == mStats.end())
+        return boost::none;
+    return it->second.total / it->second.count;
+}
+
+size_t JobTimings::count(string const& method, size_t nProc) const
+{
+    lock_guard<mutex> lock(mMutex);
+    auto it = mStats.find(make_pair(method, nProc));
+    return it == mStats.end() ? 0 : it->second.count;
+}
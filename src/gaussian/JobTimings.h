@@ -0,0 +1,26 @@
+#pragma once
+
+#include "helper.h"
+
+#include <map>
+#include <mutex>
+
+//average wall times of finished QM jobs keyed by method and core count. Every producer keeps its own, so the
+//averages describe one molecule size
+class JobTimings
+{
+public:
+    void record(string const& method, size_t nProc, double seconds);
+    optional<double> mean(string const& method, size_t nProc) const;
+    size_t count(string const& method, size_t nProc) const;
+
+private:
+    struct Stat
+    {
+        size_t count;
+        double total;
+    };
+
+    mutable mutex mMutex;
+    map<pair<string, size_t>, Stat> mStats;
+};
@@ -0,0 +1,307 @@
+#include "ProcessLauncher.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+extern char** environ;
+
+namespace
+{
+    double toSeconds(timeval const& time)
+    {
+        return time.tv_sec + time.tv_usec * 1e-6;
+    }
+
+    string readTail(string const& path, size_t bytes)
+    {
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file)
+            return "";
+
+        auto size = (size_t) file.tellg();
+        auto length = min(size, bytes);
+        file.seekg(size - length);
+
+        string tail(length, '\0');
+        file.read(&tail[0], length);
+        return tail;
+    }
+
+    vector<string> mergeEnvironment(map<string, string> const& overrides)
+    {
+        vector<string> result;
+        for (char** entry = environ; *entry; entry++) {
+            string variable = *entry;
+            if (!overrides.count(variable.substr(0, variable.find('='))))
+                result.push_back(move(variable));
+        }
+        for (auto const& variable : overrides)
+            result.push_back(variable.first + "=" + variable.second);
+
+        return result;
+    }
+
+    //the file execvp would run: names with a slash as they are, others looked up in PATH
+    string findExecutable(string const& name)
+    {
+        if (name.find('/') != string::npos)
+            return name;
+
+        char const* path = getenv("PATH");
+        string directories = path ? path : "/bin:/usr/bin";
+        for (size_t begin = 0; begin <= directories.size();) {
+            size_t end = min(directories.find(':', begin), directories.size());
+            string directory = end > begin ? directories.substr(begin, end - begin) : ".";
+            string candidate = directory + "/" + name;
+            if (!access(candidate.c_str(), X_OK))
+                return candidate;
+            begin = end + 1;
+        }
+
+        return name;
+    }
+
+    int redirect(int fd, char const* path, int flags)
+    {
+        int opened = open(path, flags, 0644);
+        if (opened < 0)
+            return -1;
+        if (opened != fd) {
+            if (dup2(opened, fd) < 0)
+                return -1;
+            close(opened);
+        }
+        return 0;
+    }
+
+    vector<char*> toPointers(vector<string>& strings)
+    {
+        vector<char*> pointers;
+        for (auto& str : strings)
+            pointers.push_back(&str[0]);
+        pointers.push_back(nullptr);
+
+        return pointers;
+    }
+}
+
+bool ProcessResult::succeeded() const
+{
+    return status == Status::Exited && code == 0;
+}
+
+ProcessHandle::ProcessHandle() : mPid(0), mCancelled(false)
+{ }
+
+void ProcessHandle::cancel()
+{
+    lock_guard<mutex> lock(mMutex);
+    mCancelled = true;
+    if (mPid > 0)
+        kill(-mPid, SIGKILL);
+}
+
+bool ProcessHandle::isCancelled()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mCancelled;
+}
+
+void ProcessHandle::attach(pid_t pid)
+{
+    lock_guard<mutex> lock(mMutex);
+    mPid = pid;
+    if (mCancelled)
+        kill(-mPid, SIGKILL);
+}
+
+void ProcessHandle::detach()
+{
+    lock_guard<mutex> lock(mMutex);
+    mPid = 0;
+}
+
+ProcessLauncher::ProcessLauncher(ProcessLimits limits) : mLimits(limits)
+{ }
+
+ProcessLauncher::~ProcessLauncher()
+{
+    cancelAll();
+}
+
+ProcessResult ProcessLauncher::run(vector<string> const& argv, string const& directory,
+                                   map<string, string> const& environment, string const& stderrPath,
+                                   shared_ptr<ProcessHandle> handle)
+{
+    auto limits = getLimits();
+    if (!handle)
+        handle = make_shared<ProcessHandle>();
+
+    auto arguments = argv;
+    auto variables = mergeEnvironment(environment);
+    auto argumentPointers = toPointers(arguments);
+    auto variablePointers = toPointers(variables);
+
+    auto executable = findExecutable(argv[0]);
+    auto directoryPath = directory;
+    auto errorPath = stderrPath;
+
+    auto unregister = [&] {
+        lock_guard<mutex> lock(mMutex);
+        mRunning.erase(handle);
+    };
+    {
+        lock_guard<mutex> lock(mMutex);
+        mRunning.insert(handle);
+    }
+
+    auto startTime = chrono::steady_clock::now();
+
+    //vfork neither copies the page tables of this large multithreaded process nor stops its other threads, only this
+    //one until the child has called exec. The child shares our memory meanwhile, so it makes nothing but system calls
+    //and leaves the errno of a failed setup or exec in childError. Signals stay blocked until then, so that no handler
+    //runs on the shared stack
+    volatile int childError = 0;
+    sigset_t allSignals, previousSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &previousSignals);
+
+    pid_t pid = vfork();
+    if (!pid) {
+        int error = setupChild(directoryPath.c_str(), errorPath.c_str(), limits);
+        if (!error) {
+            sigprocmask(SIG_SETMASK, &previousSignals, nullptr);
+            execve(executable.c_str(), argumentPointers.data(), variablePointers.data());
+            error = errno;
+        }
+        childError = error;
+        _exit(127);
+    }
+    int launchError = errno;
+    pthread_sigmask(SIG_SETMASK, &previousSignals, nullptr);
+
+    if (pid < 0) {
+        unregister();
+        throw runtime_error(format("failed to launch {}: {}", argv[0], strerror(launchError)));
+    }
+    if (childError) {
+        waitpid(pid, nullptr, 0);
+        unregister();
+        throw runtime_error(format("failed to launch {}: {}", argv[0], strerror(childError)));
+    }
+    handle->attach(pid);
+
+    bool timedOut = false;
+    bool killed = false;
+    auto killTime = startTime;
+    auto delay = chrono::milliseconds(1);
+    while (true) {
+        //WNOWAIT leaves the child a zombie, which keeps its pid from being reused until the handle is detached
+        siginfo_t info;
+        info.si_pid = 0;
+        if (waitid(P_PID, (id_t) pid, &info, WEXITED | WNOHANG | WNOWAIT) < 0 && errno != EINTR) {
+            int error = errno;
+            handle->detach();
+            unregister();
+            throw runtime_error(format("failed to wait for {}: {}", argv[0], strerror(error)));
+        }
+        if (info.si_pid == pid)
+            break;
+
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - startTime).count();
+
+        if (!timedOut && limits.timeout > 0 && elapsed > limits.timeout) {
+            timedOut = true;
+            killTime = now;
+            kill(-pid, SIGTERM);
+        }
+        if (timedOut && !killed && chrono::duration<double>(now - killTime).count() > KILL_GRACE_PERIOD) {
+            killed = true;
+            kill(-pid, SIGKILL);
+        }
+
+        this_thread::sleep_for(delay);
+        delay = min(delay * 2, chrono::milliseconds(50));
+    }
+    handle->detach();
+
+    int status = 0;
+    rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR);
+    unregister();
+
+    ProcessResult result;
+    result.wallTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    result.cpuTime = toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime);
+
+    if (WIFEXITED(status)) {
+        result.status = ProcessResult::Status::Exited;
+        result.code = WEXITSTATUS(status);
+    } else {
+        result.status = ProcessResult::Status::Signaled;
+        result.code = WTERMSIG(status);
+    }
+
+    if (timedOut)
+        result.status = ProcessResult::Status::TimedOut;
+    else if (handle->isCancelled() && !result.succeeded())
+        result.status = ProcessResult::Status::Cancelled;
+
+    if (!result.succeeded() && stderrPath != "/dev/null")
+        result.stderrTail = readTail(stderrPath, STDERR_TAIL_BYTES);
+
+    return result;
+}
+
+void ProcessLauncher::cancelAll()
+{
+    lock_guard<mutex> lock(mMutex);
+    for (auto const& handle : mRunning)
+        handle->cancel();
+}
+
+ProcessLimits ProcessLauncher::getLimits()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mLimits;
+}
+
+void ProcessLauncher::setLimits(ProcessLimits limits)
+{
+    lock_guard<mutex> lock(mMutex);
+    mLimits = limits;
+}
+
+shared_ptr<ProcessLauncher> const& ProcessLauncher::global()
+{
+    static auto const launcher = make_shared<ProcessLauncher>();
+    return launcher;
+}
+
+int ProcessLauncher::setupChild(char const* directory, char const* stderrPath, ProcessLimits const& limits)
+{
+    setpgid(0, 0);
+
+    if (redirect(STDIN_FILENO, "/dev/null", O_RDONLY) || redirect(STDOUT_FILENO, "/dev/null", O_WRONLY) ||
+        redirect(STDERR_FILENO, stderrPath, O_WRONLY | O_CREAT | O_TRUNC))
+        return errno;
+    if (chdir(directory))
+        return errno;
+
+    if (limits.memoryBytes) {
+        rlimit limit{limits.memoryBytes, limits.memoryBytes};
+        if (setrlimit(RLIMIT_AS, &limit))
+            return errno;
+    }
+    if (limits.cpuSeconds) {
+        rlimit limit{limits.cpuSeconds, limits.cpuSeconds + 1};
+        if (setrlimit(RLIMIT_CPU, &limit))
+            return errno;
+    }
+
+    return 0;
+}
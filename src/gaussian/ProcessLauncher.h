@@ -0,0 +1,87 @@
+#pragma once
+
+#include "helper.h"
+
+#include <set>
+#include <map>
+#include <mutex>
+
+struct ProcessLimits
+{
+    double timeout = 0;
+    size_t memoryBytes = 0;
+    size_t cpuSeconds = 0;
+};
+
+struct ProcessResult
+{
+    enum class Status
+    {
+        Exited, Signaled, TimedOut, Cancelled
+    };
+
+    Status status;
+    int code;
+    double wallTime;
+    double cpuTime;
+    string stderrTail;
+
+    bool succeeded() const;
+};
+
+//cancels a single launch: the process group of a running program is killed, and a launch that has not started its
+//program yet kills it as soon as it does. A handle is meant for one launch
+class ProcessHandle
+{
+public:
+    ProcessHandle();
+
+    void cancel();
+    bool isCancelled();
+
+private:
+    friend class ProcessLauncher;
+
+    mutex mMutex;
+    pid_t mPid;
+    bool mCancelled;
+
+    void attach(pid_t pid);
+    void detach();
+};
+
+//starts external programs with vfork and execve (no intermediate shell) in their own process group, so that a timeout
+//or cancellation takes down the program together with everything it forked. Memory and CPU limits are set in the
+//child before exec, so they hold from the program's first instruction on. Limits of 0 mean unlimited.
+class ProcessLauncher
+{
+public:
+    static constexpr double KILL_GRACE_PERIOD = 2.;
+    static constexpr size_t STDERR_TAIL_BYTES = 2048;
+
+    explicit ProcessLauncher(ProcessLimits limits = ProcessLimits());
+    ~ProcessLauncher();
+
+    ProcessLauncher(ProcessLauncher const&) = delete;
+    ProcessLauncher& operator=(ProcessLauncher const&) = delete;
+
+    ProcessResult run(vector<string> const& argv, string const& directory,
+                      map<string, string> const& environment = {}, string const& stderrPath = "/dev/null",
+                      shared_ptr<ProcessHandle> handle = nullptr);
+
+    void cancelAll();
+
+    ProcessLimits getLimits();
+    void setLimits(ProcessLimits limits);
+
+    static shared_ptr<ProcessLauncher> const& global();
+
+private:
+    ProcessLimits mLimits;
+
+    mutex mMutex;
+    set<shared_ptr<ProcessHandle>> mRunning;
+
+    //runs in the vforked child; returns 0 or the errno of the failed step
+    static int setupChild(char const* directory, char const* stderrPath, ProcessLimits const& limits);
+};
@@ -0,0 +1,317 @@
+#include "ResultStore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+
+#include "EvaluationCache.h"
+
+namespace
+{
+    size_t padded(size_t size)
+    {
+        return (size + 7) / 8 * 8;
+    }
+
+    size_t bodySize(size_t nAtoms, size_t order, size_t theoryLength)
+    {
+        size_t nDims = nAtoms * 3;
+        size_t size = padded(theoryLength) + padded(nAtoms * sizeof(uint32_t)) + nDims * sizeof(int64_t) + sizeof(double);
+        if (order >= 1)
+            size += nDims * sizeof(double);
+        if (order >= 2)
+            size += nDims * (nDims + 1) / 2 * sizeof(double);
+        return size;
+    }
+
+    template<typename T>
+    void put(vector<char>& buffer, size_t& offset, T const& value)
+    {
+        memcpy(buffer.data() + offset, &value, sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template<typename T>
+    T take(char const* data, size_t& offset)
+    {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+}
+
+ResultStore::ResultStore(string path) : mPath(move(path)), mData(nullptr), mMappedSize(0), mFileSize(0),
+                                        mScannedSize(0)
+{
+    mFd = open(mPath.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (mFd < 0)
+        throw runtime_error(format("can not open result store {}: {}", mPath, strerror(errno)));
+}
+
+ResultStore::~ResultStore()
+{
+    if (mData)
+        munmap((void*) mData, mMappedSize);
+    close(mFd);
+}
+
+optional<GaussianResult> ResultStore::find(vector<size_t> const& charges, vect const& x, size_t order,
+                                           string const& levelOfTheory)
+{
+    auto coords = quantize(x);
+    auto hash = keyHash(charges, coords, levelOfTheory);
+
+    lock_guard<mutex> lock(mMutex);
+    refresh();
+
+    auto range = mIndex.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        RecordHeader header;
+        memcpy(&header, mData + it->second, sizeof(header));
+        char const* body = mData + it->second + sizeof(header);
+
+        if (header.order >= order && matches(header, body, charges, coords, levelOfTheory))
+            return readResult(header, body);
+    }
+
+    return boost::none;
+}
+
+void ResultStore::append(vector<size_t> const& charges, vect const& x, size_t order, string const& levelOfTheory,
+                         GaussianResult const& result)
+{
+    assert(order == 0 || result.grad);
+    assert(order <= 1 || result.hess);
+
+    auto coords = quantize(x);
+    size_t nDims = coords.size();
+
+    RecordHeader header;
+    header.magic = MAGIC;
+    header.size = (uint32_t) (sizeof(RecordHeader) + bodySize(charges.size(), order, levelOfTheory.size()));
+    header.keyHash = keyHash(charges, coords, levelOfTheory);
+    header.nAtoms = (uint32_t) charges.size();
+    header.order = (uint32_t) order;
+    header.theoryLength = (uint32_t) levelOfTheory.size();
+    header.reserved = 0;
+
+    vector<char> buffer(header.size, 0);
+    size_t offset = sizeof(RecordHeader);
+
+    memcpy(buffer.data() + offset, levelOfTheory.data(), levelOfTheory.size());
+    offset += padded(levelOfTheory.size());
+    for (size_t i = 0; i < charges.size(); i++)
+        put(buffer, offset, (uint32_t) charges[i]);
+    offset = sizeof(RecordHeader) + padded(levelOfTheory.size()) + padded(charges.size() * sizeof(uint32_t));
+    for (size_t i = 0; i < nDims; i++)
+        put(buffer, offset, (int64_t) coords[i]);
+    put(buffer, offset, result.value);
+    if (order >= 1)
+        for (size_t i = 0; i < nDims; i++)
+            put(buffer, offset, (*result.grad)(i));
+    if (order >= 2)
+        for (size_t i = 0; i < nDims; i++)
+            for (size_t j = 0; j <= i; j++)
+                put(buffer, offset, (*result.hess)(i, j));
+    assert(offset == header.size);
+
+    header.checksum = checksum(buffer.data() + sizeof(RecordHeader), header.size - sizeof(RecordHeader));
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    flock(mFd, LOCK_EX);
+    off_t start = lseek(mFd, 0, SEEK_END);
+    for (size_t written = 0; written < buffer.size();) {
+        auto cnt = write(mFd, buffer.data() + written, buffer.size() - written);
+        if (cnt < 0 && errno != EINTR) {
+            LOG_ERROR("result store {} append failed: {}", mPath, strerror(errno));
+            //drop the partial record, so that the next append starts where this one did
+            if (start >= 0 && ftruncate(mFd, start))
+                LOG_ERROR("result store {} truncation failed: {}", mPath, strerror(errno));
+            break;
+        }
+        written += max(cnt, (ssize_t) 0);
+    }
+    flock(mFd, LOCK_UN);
+}
+
+size_t ResultStore::size()
+{
+    lock_guard<mutex> lock(mMutex);
+    refresh();
+    return mIndex.size();
+}
+
+string const& ResultStore::getPath() const
+{
+    return mPath;
+}
+
+void ResultStore::refresh()
+{
+    struct stat st;
+    if (fstat(mFd, &st))
+        return;
+
+    //a failed append in another process truncates the file, and reading pages of the old mapping that are now past
+    //its end raises SIGBUS, so the mapping follows the file in both directions
+    mFileSize = (size_t) st.st_size;
+    if (mFileSize != mMappedSize && !remap())
+        return;
+
+    if (mScannedSize > mFileSize) {
+        mScannedSize = mFileSize;
+        for (auto it = mIndex.begin(); it != mIndex.end();) {
+            RecordHeader header;
+            bool inside = it->second + sizeof(header) <= mFileSize;
+            if (inside) {
+                memcpy(&header, mData + it->second, sizeof(header));
+                inside = it->second + header.size <= mFileSize;
+            }
+            it = inside ? next(it) : mIndex.erase(it);
+        }
+    }
+
+    size_t end = readableSize();
+    while (mScannedSize + sizeof(RecordHeader) <= end) {
+        RecordHeader header;
+        memcpy(&header, mData + mScannedSize, sizeof(header));
+
+        if (isCompleteRecord(header, mScannedSize)) {
+            mIndex.emplace(header.keyHash, mScannedSize);
+            mScannedSize += header.size;
+            continue;
+        }
+
+        //either the tail is still being written, or the record was torn by a writer that died halfway and later
+        //records were appended after it. Skip to the next complete record; until there is one the scan stays here
+        //and is retried when the file grows
+        size_t next = mScannedSize + 1;
+        for (; next + sizeof(RecordHeader) <= end; next++) {
+            memcpy(&header, mData + next, sizeof(header));
+            if (isCompleteRecord(header, next))
+                break;
+        }
+        if (next + sizeof(RecordHeader) > end)
+            break;
+
+        mScannedSize = next;
+    }
+}
+
+bool ResultStore::remap()
+{
+    if (mData)
+        munmap((void*) mData, mMappedSize);
+    mData = nullptr;
+    mMappedSize = 0;
+
+    if (!mFileSize)
+        return true;
+
+    void* data = mmap(nullptr, mFileSize, PROT_READ, MAP_SHARED, mFd, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("result store {} mmap failed: {}", mPath, strerror(errno));
+        mScannedSize = 0;
+        mIndex.clear();
+        return false;
+    }
+
+    mData = (char const*) data;
+    mMappedSize = mFileSize;
+    return true;
+}
+
+size_t ResultStore::readableSize() const
+{
+    return min(mMappedSize, mFileSize);
+}
+
+bool ResultStore::isCompleteRecord(RecordHeader const& header, size_t offset) const
+{
+    if (header.magic != MAGIC || header.size < sizeof(RecordHeader) || header.size % 8 != 0)
+        return false;
+    if (offset + header.size > readableSize())
+        return false;
+
+    char const* body = mData + offset + sizeof(RecordHeader);
+    return header.size == sizeof(RecordHeader) + bodySize(header.nAtoms, header.order, header.theoryLength) &&
+           header.checksum == checksum(body, header.size - sizeof(RecordHeader));
+}
+
+bool ResultStore::matches(RecordHeader const& header, char const* body, vector<size_t> const& charges,
+                          vector<long long> const& coords, string const& levelOfTheory) const
+{
+    if (header.nAtoms != charges.size() || header.theoryLength != levelOfTheory.size())
+        return false;
+    if (memcmp(body, levelOfTheory.data(), levelOfTheory.size()))
+        return false;
+
+    size_t offset = padded(levelOfTheory.size());
+    for (size_t i = 0; i < charges.size(); i++)
+        if (take<uint32_t>(body, offset) != charges[i])
+            return false;
+
+    offset = padded(levelOfTheory.size()) + padded(charges.size() * sizeof(uint32_t));
+    for (size_t i = 0; i < coords.size(); i++)
+        if (take<int64_t>(body, offset) != coords[i])
+            return false;
+
+    return true;
+}
+
+GaussianResult ResultStore::readResult(RecordHeader const& header, char const* body) const
+{
+    size_t nDims = header.nAtoms * 3;
+    size_t offset = padded(header.theoryLength) + padded(header.nAtoms * sizeof(uint32_t)) + nDims * sizeof(int64_t);
+
+    GaussianResult result;
+    result.value = take<double>(body, offset);
+
+    if (header.order >= 1) {
+        vect grad(nDims);
+        for (size_t i = 0; i < nDims; i++)
+            grad(i) = take<double>(body, offset);
+        result.grad = grad;
+    }
+
+    if (header.order >= 2) {
+        matrix hess(nDims, nDims);
+        for (size_t i = 0; i < nDims; i++)
+            for (size_t j = 0; j <= i; j++)
+                hess(i, j) = hess(j, i) = take<double>(body, offset);
+        result.hess = hess;
+    }
+
+    return result;
+}
+
+vector<long long> ResultStore::quantize(vect const& x)
+{
+    vector<long long> coords((size_t) x.size());
+    for (size_t i = 0; i < coords.size(); i++)
+        coords[i] = llround(x(i) / EvaluationCache::GEOMETRY_QUANTUM);
+    return coords;
+}
+
+uint64_t ResultStore::keyHash(vector<size_t> const& charges, vector<long long> const& coords,
+                              string const& levelOfTheory)
+{
+    uint64_t hash = checksum(levelOfTheory.data(), levelOfTheory.size());
+    for (auto charge : charges)
+        hash = (hash ^ charge) * 1099511628211ull;
+    for (auto coord : coords)
+        hash = (hash ^ (uint64_t) coord) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t ResultStore::checksum(char const* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ull;
+    return hash;
+}
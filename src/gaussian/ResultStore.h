@@ -0,0 +1,68 @@
+#pragma once
+
+#include "helper.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "GaussianResult.h"
+
+//append-only on-disk store of QM results shared between runs and between processes on one machine.
+//Records are appended under an exclusive flock with a single write() and are validated by a checksum on read,
+//so readers need no locking and a torn record at the tail is simply ignored until it is complete. A failed append
+//truncates its partial record away; one left by a killed writer is skipped once complete records follow it.
+class ResultStore
+{
+public:
+    explicit ResultStore(string path);
+    ~ResultStore();
+
+    ResultStore(ResultStore const&) = delete;
+    ResultStore& operator=(ResultStore const&) = delete;
+
+    optional<GaussianResult> find(vector<size_t> const& charges, vect const& x, size_t order,
+                                  string const& levelOfTheory);
+    void append(vector<size_t> const& charges, vect const& x, size_t order, string const& levelOfTheory,
+                GaussianResult const& result);
+
+    size_t size();
+    string const& getPath() const;
+
+private:
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint64_t keyHash;
+        uint64_t checksum;
+        uint32_t nAtoms;
+        uint32_t order;
+        uint32_t theoryLength;
+        uint32_t reserved;
+    };
+
+    static constexpr uint32_t MAGIC = 0x31524d51;
+
+    string const mPath;
+    int mFd;
+
+    mutex mMutex;
+    char const* mData;
+    size_t mMappedSize;
+    size_t mFileSize;
+    size_t mScannedSize;
+    unordered_multimap<uint64_t, size_t> mIndex;
+
+    void refresh();
+    bool remap();
+    size_t readableSize() const;
+    bool isCompleteRecord(RecordHeader const& header, size_t offset) const;
+    bool matches(RecordHeader const& header, char const* body, vector<size_t> const& charges,
+                 vector<long long> const& coords, string const& levelOfTheory) const;
+    GaussianResult readResult(RecordHeader const& header, char const* body) const;
+
+    static vector<long long> quantize(vect const& x);
+    static uint64_t keyHash(vector<size_t> const& charges, vector<long long> const& coords,
+                            string const& levelOfTheory);
+    static uint64_t checksum(char const* data, size_t size);
+};
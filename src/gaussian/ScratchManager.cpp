@@ -0,0 +1,192 @@
+#include "ScratchManager.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <climits>
+
+ScratchManager::Lease::Lease(shared_ptr<ScratchManager> manager, string path) : mManager(move(manager)),
+                                                                                 mPath(move(path))
+{ }
+
+ScratchManager::Lease::Lease(Lease&& other) : mManager(move(other.mManager)), mPath(move(other.mPath))
+{ }
+
+ScratchManager::Lease::~Lease()
+{
+    if (mManager)
+        mManager->release(move(mPath));
+}
+
+string const& ScratchManager::Lease::getPath() const
+{
+    return mPath;
+}
+
+size_t ScratchManager::Lease::usage() const
+{
+    return directoryUsage(mPath);
+}
+
+ScratchManager::ScratchManager(string const& base, size_t poolSize) : mPoolSize(poolSize), mLastId(0), mStopped(false),
+                                                                      mUsage{0, 0, 0}
+{
+    ::mkdir(base.c_str(), 0755);
+
+    string pattern = base + "/shs." + to_string(getpid()) + ".XXXXXX";
+    if (!mkdtemp(&pattern[0]))
+        throw runtime_error(format("failed to create scratch root in {}: {}", base, strerror(errno)));
+
+    char absolutePath[PATH_MAX];
+    mRoot = (realpath(pattern.c_str(), absolutePath) ? string(absolutePath) : pattern) + "/";
+
+    mCleaner = thread([this] { clean(); });
+}
+
+ScratchManager::~ScratchManager()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mCondition.notify_all();
+    mCleaner.join();
+
+    removeDirectoryContents(mRoot);
+    ::rmdir(mRoot.c_str());
+}
+
+ScratchManager::Lease ScratchManager::acquire()
+{
+    {
+        lock_guard<mutex> lock(mMutex);
+        if (!mIdle.empty()) {
+            auto path = move(mIdle.front());
+            mIdle.pop_front();
+            return Lease(shared_from_this(), move(path));
+        }
+    }
+
+    auto path = format("{}job{}/", mRoot, ++mLastId);
+    if (::mkdir(path.c_str(), 0700))
+        throw runtime_error(format("failed to create scratch directory {}: {}", path, strerror(errno)));
+
+    return Lease(shared_from_this(), move(path));
+}
+
+string const& ScratchManager::getRoot() const
+{
+    return mRoot;
+}
+
+ScratchManager::Usage ScratchManager::getUsage()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mUsage;
+}
+
+size_t ScratchManager::getIdleDirectories()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mIdle.size();
+}
+
+//Gaussian scratch files can outgrow memory, so tmpfs is only used when GAUSS_SCRDIR points there
+string ScratchManager::defaultBase()
+{
+    char const* base = getenv("GAUSS_SCRDIR");
+    return base && *base ? base : "./tmp";
+}
+
+shared_ptr<ScratchManager> const& ScratchManager::global()
+{
+    static auto const manager = make_shared<ScratchManager>();
+    return manager;
+}
+
+void ScratchManager::release(string path)
+{
+    size_t bytes = directoryUsage(path);
+    {
+        lock_guard<mutex> lock(mMutex);
+        mUsage.jobs++;
+        mUsage.totalBytes += bytes;
+        mUsage.peakBytes = max(mUsage.peakBytes, bytes);
+        mDirty.push_back(move(path));
+    }
+    mCondition.notify_all();
+}
+
+void ScratchManager::clean()
+{
+    while (true) {
+        string path;
+        {
+            unique_lock<mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mStopped || !mDirty.empty(); });
+
+            if (mDirty.empty())
+                return;
+
+            path = move(mDirty.front());
+            mDirty.pop_front();
+        }
+
+        removeDirectoryContents(path);
+
+        lock_guard<mutex> lock(mMutex);
+        if (mIdle.size() < mPoolSize)
+            mIdle.push_back(move(path));
+        else
+            ::rmdir(path.c_str());
+    }
+}
+
+size_t directoryUsage(string const& path)
+{
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return 0;
+
+    size_t bytes = 0;
+    while (auto entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        struct stat st;
+        string child = path + "/" + name;
+        if (lstat(child.c_str(), &st))
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            bytes += directoryUsage(child);
+        else
+            bytes += (size_t) st.st_blocks * 512;
+    }
+    closedir(dir);
+
+    return bytes;
+}
+
+void removeDirectoryContents(string const& path)
+{
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return;
+
+    while (auto entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        string child = path + "/" + name;
+        struct stat st;
+        if (!lstat(child.c_str(), &st) && S_ISDIR(st.st_mode)) {
+            removeDirectoryContents(child);
+            ::rmdir(child.c_str());
+        } else
+            ::unlink(child.c_str());
+    }
+    closedir(dir);
+}
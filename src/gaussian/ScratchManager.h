@@ -0,0 +1,74 @@
+#pragma once
+
+#include "helper.h"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+
+//hands out a private scratch directory per QM job. Directories are created in-process under a root in the given base,
+//and are emptied by a background thread after release and then recycled for later jobs. A manager must be owned by a
+//shared_ptr: every lease keeps its manager alive.
+class ScratchManager : public enable_shared_from_this<ScratchManager>
+{
+public:
+    struct Usage
+    {
+        size_t jobs;
+        size_t totalBytes;
+        size_t peakBytes;
+    };
+
+    class Lease
+    {
+    public:
+        Lease(shared_ptr<ScratchManager> manager, string path);
+        Lease(Lease&& other);
+        ~Lease();
+
+        Lease(Lease const&) = delete;
+        Lease& operator=(Lease const&) = delete;
+
+        string const& getPath() const;
+        size_t usage() const;
+
+    private:
+        shared_ptr<ScratchManager> mManager;
+        string mPath;
+    };
+
+    explicit ScratchManager(string const& base = defaultBase(), size_t poolSize = 32);
+    ~ScratchManager();
+
+    ScratchManager(ScratchManager const&) = delete;
+    ScratchManager& operator=(ScratchManager const&) = delete;
+
+    Lease acquire();
+
+    string const& getRoot() const;
+    Usage getUsage();
+    size_t getIdleDirectories();
+
+    static string defaultBase();
+    static shared_ptr<ScratchManager> const& global();
+
+private:
+    string mRoot;
+    size_t const mPoolSize;
+    atomic<size_t> mLastId;
+    bool mStopped;
+
+    mutex mMutex;
+    condition_variable mCondition;
+    deque<string> mIdle;
+    deque<string> mDirty;
+    Usage mUsage;
+    thread mCleaner;
+
+    void release(string path);
+    void clean();
+};
+
+size_t directoryUsage(string const& path);
+void removeDirectoryContents(string const& path);
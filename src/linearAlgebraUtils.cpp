@@ -1,5 +1,7 @@
 #include "linearAlgebraUtils.h"
 
+#include "FixedDimensions.h"
+
 matrix makeRandomMatrix(size_t rows, size_t cols)
 {
     matrix matr(rows, cols);
@@ -119,6 +121,15 @@ matrix singularValues(matrix m)
     return (A.transpose() * m * A).diagonal().transpose();
 }
 
+vect newtonStep(matrix const& hess, vect const& grad)
+{
+    return dispatchDimension(hess.rows(), [&](auto n) -> vect {
+        using matrixN = fixed_matrix<decltype(n)::value>;
+        using vectN = fixed_vect<decltype(n)::value>;
+        return -matrixN(hess).partialPivLu().solve(vectN(grad));
+    });
+}
+
 vect toDistanceSpace(vect v, bool sorted)
 {
     assert(v.rows() % 3 == 0);
@@ -173,4 +184,145 @@ matrix horizontalStack(matrix const& a, matrix const& b)
     result.block(0, a.cols(), b.rows(), b.cols()) = b;
 
     return result;
-}
\ No newline at end of file
+}
+
+HouseholderReflection::HouseholderReflection(vect const& from, vect const& to)
+   : mNormal(from / from.norm() - to / to.norm())
+{
+    normalize();
+}
+
+HouseholderReflection::HouseholderReflection(size_t nDims) : mNormal(makeConstantVect(nDims, 0.))
+{ }
+
+void HouseholderReflection::setFromAxis(size_t axis, vect const& to, double sign)
+{
+    mNormal = to * (-sign / to.norm());
+    mNormal(axis) += 1;
+    normalize();
+}
+
+vect HouseholderReflection::apply(vect const& v) const
+{
+    vect result = v;
+    applyInPlace(result);
+    return result;
+}
+
+matrix HouseholderReflection::conjugate(matrix const& m) const
+{
+    matrix result = m;
+    vect left, right;
+    conjugateInPlace(result, left, right);
+    return result;
+}
+
+void HouseholderReflection::applyInPlace(vect& v) const
+{
+    v -= (2 * mNormal.dot(v)) * mNormal;
+}
+
+//m - 2 n l^T - 2 r n^T + 4 (n . r) n n^T for l = m^T n and r = m n, as two rank-one updates
+void HouseholderReflection::conjugateInPlace(matrix& m, vect& left, vect& right) const
+{
+    left.noalias() = m.transpose() * mNormal;
+    right.noalias() = m * mNormal;
+    double middle = mNormal.dot(right);
+
+    left *= 2;
+    right = 2 * right - (4 * middle) * mNormal;
+    m.noalias() -= mNormal * left.transpose();
+    m.noalias() -= right * mNormal.transpose();
+}
+
+vect const& HouseholderReflection::getNormal() const
+{
+    return mNormal;
+}
+
+void HouseholderReflection::normalize()
+{
+    double norm = mNormal.norm();
+    if (norm > 1e-15)
+        mNormal /= norm;
+    else
+        mNormal.setZero();
+}
+
+HouseholderRotation::HouseholderRotation(vect const& from, vect const& to) : mFirst(from, -from), mSecond(-from, to)
+{
+    if ((from / from.norm() - to / to.norm()).norm() < 1e-15)
+        mFirst = mSecond = HouseholderReflection(from, from);
+}
+
+HouseholderRotation::HouseholderRotation(HouseholderReflection first, HouseholderReflection second)
+   : mFirst(move(first)), mSecond(move(second))
+{ }
+
+size_t HouseholderRotation::nDims() const
+{
+    return (size_t) mFirst.getNormal().rows();
+}
+
+vect HouseholderRotation::apply(vect const& v) const
+{
+    return mSecond.apply(mFirst.apply(v));
+}
+
+matrix HouseholderRotation::apply(matrix const& m) const
+{
+    auto const& first = mFirst.getNormal();
+    auto const& second = mSecond.getNormal();
+
+    matrix result = m - 2 * first * (first.transpose() * m);
+    result -= 2 * second * (second.transpose() * result);
+    return result;
+}
+
+vect HouseholderRotation::applyTransposed(vect const& v) const
+{
+    return mFirst.apply(mSecond.apply(v));
+}
+
+matrix HouseholderRotation::applyTransposed(matrix const& m) const
+{
+    auto const& first = mFirst.getNormal();
+    auto const& second = mSecond.getNormal();
+
+    matrix result = m - 2 * second * (second.transpose() * m);
+    result -= 2 * first * (first.transpose() * result);
+    return result;
+}
+
+matrix HouseholderRotation::conjugate(matrix const& m) const
+{
+    return mFirst.conjugate(mSecond.conjugate(m));
+}
+
+void HouseholderRotation::applyInPlace(vect& v) const
+{
+    mFirst.applyInPlace(v);
+    mSecond.applyInPlace(v);
+}
+
+void HouseholderRotation::applyTransposedInPlace(vect& v) const
+{
+    mSecond.applyInPlace(v);
+    mFirst.applyInPlace(v);
+}
+
+void HouseholderRotation::conjugateInPlace(matrix& m, vect& left, vect& right) const
+{
+    mSecond.conjugateInPlace(m, left, right);
+    mFirst.conjugateInPlace(m, left, right);
+}
+
+matrix HouseholderRotation::toMatrix() const
+{
+    return apply(identity(nDims()));
+}
+
+HouseholderRotation HouseholderRotation::transposed() const
+{
+    return HouseholderRotation(mSecond, mFirst);
+}
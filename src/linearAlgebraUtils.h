@@ -32,6 +32,9 @@ vect projection(vect wich, vect to);
 
 matrix singularValues(matrix m);
 
+//-hess^-1 grad, solved with fixed-size matrices for the dimensions of FixedDimensions.h
+vect newtonStep(matrix const& hess, vect const& grad);
+
 vect toDistanceSpace(vect v, bool sorted=true);
 
 vect normalized(vect const& v);
@@ -58,3 +61,65 @@ public:
 private:
     matrix const mA;
 };
+
+//the reflection I - 2 w w^T taking the direction of from to the direction of to. It is never formed: vectors are
+//reflected in O(n) and matrices conjugated in O(n^2)
+class HouseholderReflection
+{
+public:
+    HouseholderReflection(vect const& from, vect const& to);
+    //the identity of the given dimension
+    explicit HouseholderReflection(size_t nDims);
+
+    //makes this the reflection of the axis-th unit vector to the direction of sign * to, without allocating
+    void setFromAxis(size_t axis, vect const& to, double sign = 1.);
+
+    vect apply(vect const& v) const;
+    matrix conjugate(matrix const& m) const;
+
+    //the same without allocating; left and right are scratch vectors
+    void applyInPlace(vect& v) const;
+    void conjugateInPlace(matrix& m, vect& left, vect& right) const;
+
+    vect const& getNormal() const;
+
+private:
+    vect mNormal;
+
+    void normalize();
+};
+
+//the rotation taking the direction of from to the direction of to in the plane they span, the same map as
+//rotationMatrix(from, to), kept as the product of two reflections: from to -from and then -from to to. For equal
+//directions both are the identity, for opposite ones only the first is left
+class HouseholderRotation
+{
+public:
+    HouseholderRotation(vect const& from, vect const& to);
+
+    size_t nDims() const;
+
+    vect apply(vect const& v) const;
+    matrix apply(matrix const& m) const;
+    vect applyTransposed(vect const& v) const;
+    matrix applyTransposed(matrix const& m) const;
+
+    //R^T m R
+    matrix conjugate(matrix const& m) const;
+
+    //the same without allocating; left and right are scratch vectors
+    void applyInPlace(vect& v) const;
+    void applyTransposedInPlace(vect& v) const;
+    void conjugateInPlace(matrix& m, vect& left, vect& right) const;
+
+    matrix toMatrix() const;
+
+    //the inverse rotation, the same reflections in the reverse order
+    HouseholderRotation transposed() const;
+
+private:
+    HouseholderReflection mFirst;
+    HouseholderReflection mSecond;
+
+    HouseholderRotation(HouseholderReflection first, HouseholderReflection second);
+};
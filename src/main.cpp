@@ -1,5 +1,6 @@
 #include "helper.h"
 
+#include <map>
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <Eigen/LU>
@@ -146,29 +147,53 @@ matrix tensorOfInertia(vector<size_t> charges, vector<vect> const& rs)
     return J;
 }
 
+//indices of structures grouped by their charges: each group is evaluated as one batch of one producer
+map<vector<size_t>, vector<size_t>> groupByCharges(vector<vector<size_t>> const& charges)
+{
+    map<vector<size_t>, vector<size_t>> groups;
+    for (size_t i = 0; i < charges.size(); i++)
+        groups[charges[i]].push_back(i);
+    return groups;
+}
+
 void analizeFolder()
 {
-    vector<double> energies;
+    vector<vector<size_t>> charges;
     vector<vect> states;
     for (size_t i = 0; i < 200; i++) {
-        vector<size_t> charges;
+        vector<size_t> stateCharges;
         vect state;
-        tie(charges, state) = readChemcraft(ifstream(str(boost::format("./2/%1%.xyz") % i)));
+        tie(stateCharges, state) = readChemcraft(ifstream(str(boost::format("./2/%1%.xyz") % i)));
+        charges.push_back(stateCharges);
+        states.push_back(state);
+    }
 
-        GaussianProducer molecule(charges);
+    vector<double> energies(states.size());
+    vector<vect> grads(states.size());
+    vector<matrix> hesses(states.size());
+    vector<vect> fullStates(states.size());
+    for (auto const& group : groupByCharges(charges)) {
+        GaussianProducer molecule(group.first);
         auto fixed = fixAtomSymmetry(molecule);
-        state = fixed.backTransform(state);
-
-        auto hess = fixed.hess(state);
-        auto grad = fixed.grad(state);
-        auto energy = fixed(state);
 
-        energies.push_back(energy);
-        states.push_back(state);
+        matrix batch(fixed.nDims, group.second.size());
+        for (size_t j = 0; j < group.second.size(); j++)
+            batch.col(j) = states[group.second[j]] = fixed.backTransform(states[group.second[j]]);
+        auto evaluated = fixed.evaluateBatch(batch, 2);
+
+        for (size_t j = 0; j < group.second.size(); j++) {
+            size_t i = group.second[j];
+            energies[i] = evaluated.values(j);
+            grads[i] = evaluated.grads.col(j);
+            hesses[i] = evaluated.hesses[j];
+            fullStates[i] = fixed.fullTransform(states[i]);
+        }
+    }
 
+    for (size_t i = 0; i < states.size(); i++) {
         LOG_INFO("State #{}: {}\n\tenergy = {}\n\tgradient = {} [{}]\n\thess values = {}\nchemcraft coords:\n{}", i,
-                 state.transpose(), energy, grad.norm(), grad.transpose(), singularValues(hess),
-                 toChemcraftCoords(charges, fixed.fullTransform(state)));
+                 states[i].transpose(), energies[i], grads[i].norm(), grads[i].transpose(), singularValues(hesses[i]),
+                 toChemcraftCoords(charges[i], fullStates[i]));
     }
 
     framework.plot(framework.newPlot(), energies);
@@ -218,10 +243,11 @@ template<typename FuncT>
 vector<vect> filterBySingularValues(vector<vect> const& vs, FuncT& func)
 {
     vector<vect> result;
+    auto shared = share(func);
 
     for (auto const& v : vs) {
-        auto polar = makePolarWithDirection(func, 0.1, v);
-        auto sValues = singularValues(polar.hess(makeConstantVect(polar.nDims, M_PI / 2)));
+        auto onSphere = makeOnSphere(shared, 0.1, v);
+        auto sValues = singularValues(onSphere.hess(makeConstantVect(onSphere.nDims, 0.)));
 
         bool flag = true;
         for (size_t i = 0; flag && i < sValues.size(); i++)
@@ -275,8 +301,8 @@ void analizeMinsOnSphere()
         mins2 << v.size() << endl << fixed << v.transpose() << endl;
 
     for (auto const& v : vs) {
-        auto polar = makePolarWithDirection(normalized, .1, v);
-        logFunctionInfo(polar, makeConstantVect(polar.nDims, M_PI / 2), "");
+        auto onSphere = makeOnSphere(normalized, .1, v);
+        logFunctionInfo(onSphere, makeConstantVect(onSphere.nDims, 0.), "");
     }
 }
 
@@ -315,8 +341,8 @@ void findInitialPolarDirections(FuncT& func, double r)
             framework.plot(axis, xs, ys);
             framework.scatter(axis, xs, ys);
 
-            auto polar = makePolarWithDirection(func, r, path.back());
-            logFunctionInfo(polar, makeConstantVect(polar.nDims, M_PI / 2),
+            auto onSphere = makeOnSphere(func, r, path.back());
+            logFunctionInfo(onSphere, makeConstantVect(onSphere.nDims, 0.),
                             str(format("new direction (%1%)") % path.back().transpose()));
         }
     }
@@ -325,7 +351,7 @@ void findInitialPolarDirections(FuncT& func, double r)
 template<typename FuncT>
 void minimaBruteForce(FuncT&& func)
 {
-    func.getFullInnerFunction().setGaussianNProc(1);
+    func.getFullInnerFunction().setNProc(1);
     auto zeroEnergy = func(makeConstantVect(func.nDims, 0));
 
     double const r = .01;
@@ -380,7 +406,7 @@ void minimaBruteForce(FuncT&& func)
 template<typename FuncT>
 void researchPaths(FuncT&& normalized)
 {
-    normalized.getFullInnerFunction().setGaussianNProc(1);
+    normalized.getFullInnerFunction().setNProc(1);
 
     RandomProjection projection(15);
     auto axis1 = framework.newPlot("true distance space");
@@ -434,19 +460,22 @@ void researchPaths(FuncT&& normalized)
 
         vect prev_structure = structures[0];
 
-        #pragma omp parallel for
-        for (size_t j = 0; j < charges.size(); j++) {
-            auto structure = structures[j];
-            auto curCharges = charges[j];
+        for (auto const& group : groupByCharges(charges)) {
+            GaussianProducer molecule(group.first, 3);
 
-            GaussianProducer molecule(curCharges, 3);
+            matrix batch(molecule.nDims, group.second.size());
+            for (size_t j = 0; j < group.second.size(); j++)
+                batch.col(j) = structures[group.second[j]];
+            auto evaluated = molecule.evaluateBatch(batch, 2);
 
-            auto valueGradHess = molecule.valueGradHess(structure);
-            values[j] = get<0>(valueGradHess);
-            grads[j] = get<1>(valueGradHess);
-            hess[j] = get<2>(valueGradHess);
+            for (size_t j = 0; j < group.second.size(); j++) {
+                size_t k = group.second[j];
+                values[k] = evaluated.values(j);
+                grads[k] = evaluated.grads.col(j);
+                hess[k] = evaluated.hesses[j];
 
-            coordGrads[j] = normalized.getBasis().transpose() * normalized.getInnerFunction().getBasis().transpose() * get<1>(valueGradHess);
+                coordGrads[k] = normalized.getBasis().transpose() * normalized.getInnerFunction().getBasis().transpose() * grads[k];
+            }
         }
 
         vector<double> gradNorms(charges.size());
@@ -576,7 +605,7 @@ vector<vect> steepestGradientDescent(GaussianProducer& producer, vect structure,
 void process(GaussianProducer& molecule, vect const& structure)
 {
     LOG_INFO("Pre optimize structure:\n {}", toChemcraftCoords(molecule.getCharges(), structure));
-    if (auto optimized = optimize(molecule, structure)) {
+    if (auto optimized = tryToOptimize(molecule, structure)) {
         LOG_INFO("Optimized structure:\n {}\n", toChemcraftCoords(molecule.getCharges(), *optimized));
         logFunctionInfo(molecule, *optimized);
     }
@@ -584,7 +613,7 @@ void process(GaussianProducer& molecule, vect const& structure)
         LOG_INFO("Optimization not finished");
 }
 
-int main()
+int main(int argc, char* argv[])
 {
     initializeLogger();
 
@@ -595,7 +624,21 @@ int main()
     vector<size_t> charges;
     tie(charges, equilStruct) = readChemcraft(structInput);
 
+    string backend = argc > 1 ? argv[1] : "gaussian";
+    if (backend == "morse") {
+        MorseMolecule molecule(charges);
+        workflow(molecule, molecule.optimize(equilStruct), .04, 10);
+        return 0;
+    }
+
+    ProcessLimits limits;
+    limits.timeout = 3600;
+    ProcessLauncher::global()->setLimits(limits);
+
     GaussianProducer molecule(charges, 3);
+    molecule.setResultStore(make_shared<ResultStore>("./qm_results.store"));
+    molecule.setHessianReuse(make_shared<HessianHistory>());
+    molecule.setHessianMode(GaussianProducer::HessianMode::Auto);
     workflow(molecule, equilStruct, .04, 10);
 
 //    vector<vector<size_t>> chargesEq;
@@ -34,7 +34,7 @@ void createInputAndExecute(string const &method, size_t nProc, size_t mem)
     inputFile << boost::format(PATTERN) % nProc % mem % method % filemask;
     inputFile.close();
 
-    system(str(boost::format("mg09D %1%.in %1%.out > /dev/null") % filemask).c_str());
+    ProcessLauncher::global()->run({"mg09D", filemask + ".in", filemask + ".out"}, ".");
 }
 
 void runBenchmark(string const &method, size_t nProc, size_t mem, size_t iters, bool parallel)
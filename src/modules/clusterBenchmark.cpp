@@ -0,0 +1,75 @@
+#include "helper.h"
+
+#include <gtest/gtest.h>
+
+#include "linearAlgebraUtils.h"
+#include "producers/producers.h"
+#include "normalCoordinates.h"
+
+double getTimeFromNow(chrono::time_point<chrono::system_clock> const& timePoint);
+
+vect makeCluster(size_t side, double spacing)
+{
+    vect x(side * side * side * 3);
+    for (size_t i = 0; i < side; i++)
+        for (size_t j = 0; j < side; j++)
+            for (size_t k = 0; k < side; k++)
+                x.segment<3>(((i * side + j) * side + k) * 3) = Eigen::Vector3d(i, j, k) * spacing;
+    return x + .05 * makeRandomVect(x.rows());
+}
+
+template<typename FuncT>
+double timeIt(FuncT&& func, size_t iters)
+{
+    auto startTime = chrono::system_clock::now();
+    for (size_t i = 0; i < iters; i++)
+        func();
+    return getTimeFromNow(startTime) / iters;
+}
+
+TEST(Benchmark, PairPotentialClusters)
+{
+    initializeLogger();
+
+    for (size_t side : {4ul, 5ul, 6ul, 7ul, 8ul}) {
+        auto x = makeCluster(side, 1.1);
+        vector<size_t> charges((size_t) x.rows() / 3, 18);
+
+        LennardJonesCluster lj(charges);
+        MorseCluster morse(charges, Morse(), 2.5);
+
+        double ljGrad = timeIt([&] { lj.valueGrad(x); }, 20);
+        double ljHess = timeIt([&] { lj.valueGradHess(x); }, 5);
+        double morseGrad = timeIt([&] { morse.valueGrad(x); }, 20);
+        double morseHess = timeIt([&] { morse.valueGradHess(x); }, 5);
+
+        LOG_INFO("{} atoms: LJ all pairs {:.5f}s grad, {:.5f}s hess; Morse cell list {:.5f}s grad, {:.5f}s hess",
+                 charges.size(), ljGrad, ljHess, morseGrad, morseHess);
+    }
+}
+
+TEST(Benchmark, ClusterWorkflowStages)
+{
+    initializeLogger();
+
+    for (size_t nAtoms : {8ul, 13ul}) {
+        vect x = makeCluster(3, 1.1).head(nAtoms * 3);
+        vector<size_t> charges(nAtoms, 18);
+        MorseCluster morse(charges, Morse(), 2.5);
+
+        double normal = timeIt([&] { remove6LesserHessValues(morse, x); }, 1);
+
+        auto normalCoords = remove6LesserHessValues(morse, x);
+        auto direction = normalized(makeRandomVect(normalCoords.nDims));
+        auto polar = makePolarWithDirection(normalCoords, .1, direction);
+        auto theta = makeConstantVect(polar.nDims, M_PI / 2);
+        double polarHess = timeIt([&] { polar.valueGradHess(theta); }, 3);
+
+        auto onSphere = makeOnSphere(normalCoords, .1, direction);
+        auto zero = makeConstantVect(onSphere.nDims, 0.);
+        double onSphereHess = timeIt([&] { onSphere.valueGradHess(zero); }, 3);
+
+        LOG_INFO("{} atoms: remove6LesserHessValues {:.4f}s, InPolar valueGradHess {:.4f}s, OnSphere valueGradHess "
+                 "{:.4f}s", charges.size(), normal, polarHess, onSphereHess);
+    }
+}
@@ -0,0 +1,93 @@
+#include "helper.h"
+
+#include <gtest/gtest.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include <sys/stat.h>
+
+#include "linearAlgebraUtils.h"
+#include "gaussian/FchkParser.h"
+
+double getTimeFromNow(chrono::time_point<chrono::system_clock> const& timePoint);
+
+void makeDirectory(string const& path)
+{
+    if (::mkdir(path.c_str(), 0755) && errno != EEXIST)
+        throw runtime_error(format("failed to create fixture directory {}: {}", path, strerror(errno)));
+}
+
+string createFixture(size_t nAtoms)
+{
+    makeDirectory("./tmp");
+    makeDirectory("./tmp/fchk_fixtures");
+    string path = format("./tmp/fchk_fixtures/{}.fchk", nAtoms);
+
+    mt19937 random(nAtoms);
+    size_t nDims = nAtoms * 3;
+
+    GaussianResult result;
+    result.value = -78.5;
+    result.grad = makeRandomVect(nDims, random);
+    matrix hess = makeRandomMatrix(nDims, nDims);
+    result.hess = matrix(hess + hess.transpose());
+
+    ofstream output(path);
+    writeFchk(output, "benchmark fixture", vector<size_t>(nAtoms, 6), makeRandomVect(nDims, random), result);
+
+    return path;
+}
+
+//the getline/operator>> parsing that formchk output used to go through
+GaussianResult parseWithStreams(string const& path, size_t nDims)
+{
+    ifstream input(path);
+    string s;
+    GaussianResult result;
+
+    while (!boost::starts_with(s, "Total Energy"))
+        getline(input, s);
+    stringstream ss(s);
+    ss >> s >> s >> s >> result.value;
+
+    while (!boost::starts_with(s, "Cartesian Gradient"))
+        getline(input, s);
+    vect grad(nDims);
+    for (size_t i = 0; i < nDims; i++)
+        input >> grad(i);
+    result.grad = grad;
+
+    while (!boost::starts_with(s, "Cartesian Force Constants"))
+        getline(input, s);
+    matrix hess(nDims, nDims);
+    for (size_t i = 0; i < nDims; i++)
+        for (size_t j = 0; j <= i; j++) {
+            input >> hess(i, j);
+            hess(j, i) = hess(i, j);
+        }
+    result.hess = hess;
+
+    return result;
+}
+
+TEST(Benchmark, FchkParser)
+{
+    initializeLogger();
+
+    size_t const ITERS = 200;
+
+    for (size_t nAtoms : {3ul, 6ul, 12ul, 24ul, 48ul, 96ul}) {
+        auto path = createFixture(nAtoms);
+        size_t nDims = nAtoms * 3;
+
+        auto startTime = chrono::system_clock::now();
+        for (size_t i = 0; i < ITERS; i++)
+            parseWithStreams(path, nDims);
+        double streams = getTimeFromNow(startTime) / ITERS;
+
+        startTime = chrono::system_clock::now();
+        for (size_t i = 0; i < ITERS; i++)
+            parseFchk(path, nDims, 2, 1.);
+        double mapped = getTimeFromNow(startTime) / ITERS;
+
+        LOG_INFO("{} atoms: {:.6f}s streams, {:.6f}s mapped ({:.1f}x)", nAtoms, streams, mapped, streams / mapped);
+    }
+}
@@ -58,8 +58,8 @@ void findInitialPolarDirections(FuncT& func, double r)
             framework.plot(axis, xs, ys);
             framework.scatter(axis, xs, ys);
 
-            auto polar = makePolarWithDirection(func, r, path.back());
-            logFunctionInfo(polar, makeConstantVect(polar.nDims, M_PI / 2), "new initial polar direction");
+            auto onSphere = makeOnSphere(func, r, path.back());
+            logFunctionInfo(onSphere, makeConstantVect(onSphere.nDims, 0.), "new initial polar direction");
         }
     }
 }
@@ -0,0 +1,40 @@
+#include "helper.h"
+
+#include <gtest/gtest.h>
+
+#include "linearAlgebraUtils.h"
+#include "FixedDimensions.h"
+
+double getTimeFromNow(chrono::time_point<chrono::system_clock> const& timePoint);
+
+//newtonStep against the dynamic LU it replaces, over the fixed range and a little around it: every dimension in the
+//range costs an instantiation, so each of them should still come out faster
+TEST(Benchmark, FixedDimensionsNewtonStep)
+{
+    initializeLogger();
+
+    size_t const ITERS = 100000;
+
+    for (size_t n = MIN_FIXED_DIMS - 1; n <= MAX_FIXED_DIMS + 2; n++) {
+        matrix a = makeRandomMatrix(n, n);
+        matrix hess = a * a.transpose() + matrix::Identity(n, n);
+        vect grad = makeRandomVect(n);
+        double checksum = 0;
+
+        auto startTime = chrono::system_clock::now();
+        for (size_t i = 0; i < ITERS; i++) {
+            vect step = -hess.partialPivLu().solve(grad);
+            checksum += step(0);
+        }
+        double dynamicTime = getTimeFromNow(startTime) / ITERS * 1e9;
+
+        startTime = chrono::system_clock::now();
+        for (size_t i = 0; i < ITERS; i++)
+            checksum -= newtonStep(hess, grad)(0);
+        double fixedTime = getTimeFromNow(startTime) / ITERS * 1e9;
+
+        LOG_INFO("{} dims{}: dynamic LU {:.0f}ns, newtonStep {:.0f}ns, x{:.2f} (checksum {:.1e})", n,
+                 n >= (size_t) MIN_FIXED_DIMS && n <= (size_t) MAX_FIXED_DIMS ? " (fixed)" : "", dynamicTime,
+                 fixedTime, dynamicTime / fixedTime, checksum);
+    }
+}
@@ -0,0 +1,53 @@
+#include "helper.h"
+
+#include <gtest/gtest.h>
+
+#include "linearAlgebraUtils.h"
+#include "producers/producers.h"
+
+double getTimeFromNow(chrono::time_point<chrono::system_clock> const& timePoint);
+
+template<typename FuncT>
+double timePerCall(FuncT&& func, size_t iters)
+{
+    auto startTime = chrono::system_clock::now();
+    for (size_t i = 0; i < iters; i++)
+        func();
+    return getTimeFromNow(startTime) / iters * 1e9;
+}
+
+//a four-layer wrapper stack over a cheap leaf, entered through FunctionProducer& as callers holding a type-erased
+//producer do and through statically(stack), which binds every call at compile time. The leaf alone is timed as well:
+//what is left of the stack time after it is the work of the layers themselves, their basis products, reflections
+//and trigonometry
+TEST(Benchmark, ProducerStackDispatch)
+{
+    initializeLogger();
+
+    size_t const ITERS = 200000;
+
+    for (size_t nDims : {4ul, 8ul, 16ul}) {
+        SqrNorm leaf(nDims);
+        auto affine = makeAffineTransfomation(leaf, makeRandomVect(nDims), makeRandomMatrix(nDims, nDims));
+        auto onSphere = makeOnSphere(affine, 1., makeRandomVect(nDims));
+        auto fixed = fix(onSphere, {0}, {.1});
+        auto stack = makePolar(fixed, 1.);
+
+        FunctionProducer& leafRef = leaf;
+        FunctionProducer& stackRef = stack;
+        auto staticStack = statically(stack);
+        vect x = makeRandomVect(nDims);
+        vect phi = makeConstantVect(stack.nDims, M_PI / 2);
+
+        Evaluation evaluation;
+        for (size_t order : {0ul, 1ul, 2ul}) {
+            double leafTime = timePerCall([&] { leafRef.evaluateInto(x, order, evaluation); }, ITERS);
+            double virtualTime = timePerCall([&] { stackRef.evaluateInto(phi, order, evaluation); }, ITERS);
+            double staticTime = timePerCall([&] { staticStack.evaluateInto(phi, order, evaluation); }, ITERS);
+
+            LOG_INFO("{} dims, order {}: leaf {:.1f}ns, stack through FunctionProducer& {:.1f}ns ({:.1f}ns per layer), "
+                     "through statically() {:.1f}ns ({:.1f}ns per layer)", nDims, order, leafTime, virtualTime,
+                     (virtualTime - leafTime) / 4, staticTime, (staticTime - leafTime) / 4);
+        }
+    }
+}
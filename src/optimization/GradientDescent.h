@@ -19,23 +19,23 @@ namespace optimization
         vector<vect> operator()(FuncT& func, vect p)
         {
             vector<vect> path;
+            Evaluation evaluation;
 
             for (size_t iter = 0;; iter++) {
                 path.push_back(p);
 
-                vect grad;
-                double val = 0;
-
                 try {
-                    grad = func.grad(p);
-                    val = func(p);
+                    func.evaluateInto(p, 1, evaluation);
                 }
                 catch (GaussianException const& exc) {
                     LOG_ERROR("Gaussian Exception: {}", exc.what());
-                    val = 0;
-                    grad.setZero();
+                    evaluation.value = 0;
+                    evaluation.grad.setZero(func.nDims);
                 }
 
+                auto const& val = evaluation.value;
+                auto const& grad = evaluation.grad;
+
                 auto delta = mDeltaStrategy(iter, p, val, grad);
                 if (mStopStrategy(iter, p, val, grad, delta))
                     break;
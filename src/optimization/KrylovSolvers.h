@@ -0,0 +1,56 @@
+#pragma once
+
+#include "helper.h"
+
+#include "linearAlgebraUtils.h"
+
+namespace optimization
+{
+    //applies |A|^-1, the inverse with all eigenvalues taken by absolute value, to b for symmetric A known only through
+    //apply(v) = A v. The Lanczos tridiagonalization of A on the Krylov subspace of b is inverted exactly, so this is
+    //the matrix-free counterpart of experimentalInverse: along every curvature direction the step has Newton length
+    //and it stays a descent direction when A is indefinite. Stops once the result changes by less than tolerance
+    template<typename OperatorT>
+    vect lanczosAbsoluteSolve(OperatorT&& apply, vect const& b, double tolerance = 1e-6, size_t iterLimit = 0)
+    {
+        size_t n = (size_t) b.rows();
+        if (!iterLimit)
+            iterLimit = n;
+        iterLimit = min(iterLimit, n);
+
+        vect x = makeConstantVect(n, 0.);
+        double beta1 = b.norm();
+        if (beta1 == 0)
+            return x;
+
+        matrix q(n, iterLimit);
+        matrix t = matrix::Zero(iterLimit, iterLimit);
+        q.col(0) = b / beta1;
+
+        for (size_t k = 0; k < iterLimit; k++) {
+            vect w = apply(q.col(k));
+            t(k, k) = q.col(k).dot(w);
+
+            //full reorthogonalization: the basis is small and every product may be a pair of QM jobs
+            for (size_t pass = 0; pass < 2; pass++)
+                w -= q.leftCols(k + 1) * (q.leftCols(k + 1).transpose() * w);
+
+            Eigen::SelfAdjointEigenSolver<matrix> solver(t.topLeftCorner(k + 1, k + 1));
+            vect values = solver.eigenvalues().cwiseAbs().cwiseMax(numeric_limits<double>::epsilon());
+            vect y = solver.eigenvectors() * (solver.eigenvectors().row(0).transpose() * beta1).cwiseQuotient(values);
+
+            vect lastX = x;
+            x = q.leftCols(k + 1) * y;
+
+            double beta = w.norm();
+            if (k + 1 == iterLimit || beta <= numeric_limits<double>::epsilon() * (abs(t(k, k)) + beta1) ||
+                (x - lastX).norm() < tolerance * x.norm())
+                break;
+
+            t(k, k + 1) = t(k + 1, k) = beta;
+            q.col(k + 1) = w / beta;
+        }
+
+        return x;
+    }
+}
@@ -21,26 +21,25 @@ namespace optimization
         vector<vect> operator()(FuncT& func, vect p)
         {
             vector<vect> path;
+            Evaluation evaluation;
 
             for (size_t iter = 0;; iter++) {
                 path.push_back(p);
 
-                matrix hess(func.nDims, func.nDims);
-                vect grad(func.nDims);
-                double val = 0;
-
                 try {
-                    hess = func.hess(p);
-                    grad = func.grad(p);
-                    val = func(p);
+                    func.evaluateInto(p, 2, evaluation);
                 }
                 catch (GaussianException const& exc) {
                     LOG_ERROR("Gaussian Exception: {}", exc.what());
-                    val = 0;
-                    grad.setZero();
-                    hess.setZero();
+                    evaluation.value = 0;
+                    evaluation.grad.setZero(func.nDims);
+                    evaluation.hess.setZero(func.nDims, func.nDims);
                 }
 
+                auto const& val = evaluation.value;
+                auto const& grad = evaluation.grad;
+                auto const& hess = evaluation.hess;
+
                 auto delta = mDeltaStrategy(iter, p, val, grad, hess);
                 if (mStopStrategy(iter, p, val, grad, hess, delta))
                     break;
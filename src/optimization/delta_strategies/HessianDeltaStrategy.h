@@ -2,6 +2,8 @@
 
 #include "helper.h"
 
+#include "linearAlgebraUtils.h"
+
 namespace optimization
 {
     class HessianDeltaStrategy
@@ -12,7 +14,7 @@ namespace optimization
 //            if (iter < 20)
 //                return -grad;
 //            else
-                return -hess.inverse() * grad;
+                return newtonStep(hess, grad);
         }
     };
 }
\ No newline at end of file
@@ -27,6 +27,24 @@ namespace optimization {
         }
     };
 
+    //mix of SR1 and PSB updates that does not force positive definiteness, so it suits saddle point searches
+    struct Bofill {
+        void update(matrix &B, vect const& dx, vect const& dy) {
+            vect r = dy - B * dx;
+            double rx = r.dot(dx);
+            double xx = dx.dot(dx);
+            double rr = r.dot(r);
+            if (rr * xx == 0)
+                return;
+
+            double phi = rx * rx / (rr * xx);
+            matrix psb = (r * dx.transpose() + dx * r.transpose()) / xx - rx * dx * dx.transpose() / (xx * xx);
+            if (phi > 0)
+                B += phi * r * r.transpose() / rx;
+            B += (1 - phi) * psb;
+        }
+    };
+
     template<typename UpdaterT>
     class QuasiNewtonDeltaStrategy {
     public:
@@ -61,7 +79,7 @@ namespace optimization {
             if (iter < 4)
                 return -grad;
             else
-                return -mB.inverse() * grad;
+                return newtonStep(mB, grad);
         }
 
         void initializeHessian(matrix hess)
@@ -3,9 +3,13 @@
 #include "helper.h"
 
 #include "linearAlgebraUtils.h"
+#include "PythongraphicsFramework.h"
 #include "producers/AffineTransformation.h"
 #include "producers/GaussianProducer.h"
 #include "producers/InPolar.h"
+#include "producers/OnSphere.h"
+#include "producers/SharedProducer.h"
+#include "KrylovSolvers.h"
 
 namespace optimization
 {
@@ -26,18 +30,22 @@ namespace optimization
     template<typename FuncT, typename StopStrategy>
     bool experimentalTryToConverge(StopStrategy stopStrategy, FuncT& func, vect p, double r, vector<vect>& path,
                                    size_t iterLimit = 5, size_t globalIter = 0, bool needSingularTest = true) {
-        auto const theta = makeConstantVect(func.nDims - 1, M_PI / 2);
+        auto const zero = makeConstantVect(func.nDims - 1, 0.);
+        auto shared = share(func);
         bool converged = false;
 
+        HessianReuseScope reuse;
         vector<vect> newPath;
+        Evaluation evaluation;
+        auto onSphere = makeOnSphere(shared, r, p);
         try {
             for (size_t i = 0; i < iterLimit; i++) {
-                auto polar = makePolarWithDirection(func, r, p);
+                onSphere.recenter(p);
 
-                auto valueGradHess = polar.valueGradHess(theta);
-                auto value = get<0>(valueGradHess);
-                auto grad = get<1>(valueGradHess);
-                auto hess = get<2>(valueGradHess);
+                onSphere.evaluateInto(zero, 2, evaluation);
+                auto const& value = evaluation.value;
+                auto const& grad = evaluation.grad;
+                auto const& hess = evaluation.hess;
 
                 if (needSingularTest) {
                     auto sValues = singularValues(hess);
@@ -51,7 +59,7 @@ namespace optimization
                 }
 
                 auto lastP = p;
-                p = polar.getInnerFunction().transform(polar.transform(theta - experimentalInverse(hess) * grad));
+                p = onSphere.transform(-experimentalInverse(hess) * grad);
                 newPath.push_back(p);
 
                 if (stopStrategy(globalIter + i, p, value, grad, hess, p - lastP)) {
@@ -72,21 +80,75 @@ namespace optimization
         return false;
     };
 
+    //from this many dimensions on, the Newton steps of optimizeOnSphere are Lanczos solves: a Hessian costs as many
+    //gradients as there are dimensions, while the solve usually converges in far fewer Hessian-vector products
+    constexpr size_t KRYLOV_MIN_DIMS = 90;
+
+    //same Newton iterations as experimentalTryToConverge, but every step is a Lanczos solve built from Hessian-vector
+    //products, so the Hessian is never formed
+    template<typename FuncT, typename StopStrategy>
+    bool krylovTryToConverge(StopStrategy stopStrategy, FuncT& func, vect p, double r, vector<vect>& path,
+                             size_t iterLimit = 5, size_t globalIter = 0, double tolerance = 1e-3)
+    {
+        auto const zero = makeConstantVect(func.nDims - 1, 0.);
+        auto shared = share(func);
+        bool converged = false;
+
+        vector<vect> newPath;
+        Evaluation evaluation;
+        auto onSphere = makeOnSphere(shared, r, p);
+        try {
+            for (size_t i = 0; i < iterLimit; i++) {
+                onSphere.recenter(p);
+
+                onSphere.evaluateInto(zero, 1, evaluation);
+                auto const& value = evaluation.value;
+                auto const& grad = evaluation.grad;
+
+                auto delta = lanczosAbsoluteSolve([&](vect const& v) { return onSphere.hessVec(zero, v); }, grad,
+                                                  tolerance);
+
+                auto lastP = p;
+                p = onSphere.transform(-delta);
+                newPath.push_back(p);
+
+                if (stopStrategy(globalIter + i, p, value, grad, p - lastP)) {
+                    converged = true;
+                    break;
+                }
+            }
+        } catch (GaussianException const& exc) {
+            LOG_ERROR("GaussianException converge break");
+            return false;
+        }
+
+        if (converged) {
+            path.insert(path.end(), newPath.begin(), newPath.end());
+            return true;
+        }
+
+        return false;
+    };
+
     template<typename FuncT, typename StopStrategy>
     bool tryToConverge(StopStrategy stopStrategy, FuncT& func, vect p, double r, vector<vect>& path, size_t iterLimit=5, size_t globalIter=0, bool needSingularTest=true)
     {
-        auto const theta = makeConstantVect(func.nDims - 1, M_PI / 2);
+        auto const zero = makeConstantVect(func.nDims - 1, 0.);
+        auto shared = share(func);
         bool converged = false;
 
+        HessianReuseScope reuse;
         vector<vect> newPath;
+        Evaluation evaluation;
+        auto onSphere = makeOnSphere(shared, r, p);
 //        try {
             for (size_t i = 0; i < iterLimit; i++) {
-                auto polar = makePolarWithDirection(func, r, p);
+                onSphere.recenter(p);
 
-                auto valueGradHess = polar.valueGradHess(theta);
-                auto value = get<0>(valueGradHess);
-                auto grad = get<1>(valueGradHess);
-                auto hess = get<2>(valueGradHess);
+                onSphere.evaluateInto(zero, 2, evaluation);
+                auto const& value = evaluation.value;
+                auto const& grad = evaluation.grad;
+                auto const& hess = evaluation.hess;
 
                 if (needSingularTest) {
                     auto sValues = singularValues(hess);
@@ -100,7 +162,7 @@ namespace optimization
                 }
 
                 auto lastP = p;
-                p = polar.getInnerFunction().transform(polar.transform(theta - hess.inverse() * grad));
+                p = onSphere.transform(newtonStep(hess, grad));
                 newPath.push_back(p);
 
                 if (stopStrategy(globalIter + i, p, value, grad, hess, p - lastP)) {
@@ -120,15 +182,43 @@ namespace optimization
         return false;
     };
 
+    //one iteration of the momentum descent of optimizeOnSphere: moves the tangent space of onSphere to p, evaluates the
+    //gradient there, adds it to momentum damped by how well the two agree and moves p against momentum. step is
+    //scratch; once all of the vectors have their sizes, an iteration does not allocate. Returns the damping factor
+    template<typename FuncT>
+    double momentumStepOnSphere(OnSphere<FuncT>& onSphere, double r, vect& p, vect& momentum, vect& step,
+                                Evaluation& evaluation, bool first)
+    {
+        onSphere.recenter(p);
+        step.setZero(onSphere.nDims);
+        onSphere.evaluateInto(step, 1, evaluation);
+        auto const& grad = evaluation.grad;
+
+        double factor = 0;
+        if (first)
+            momentum = grad / r;
+        else {
+            factor = sqrt(max(0., momentum.dot(grad) / (momentum.norm() * grad.norm()) + 1e-2));
+            momentum = factor * momentum + grad / r;
+        }
+
+        step = -momentum;
+        onSphere.transformInto(step, p);
+        return factor;
+    }
+
     template<typename FuncT, typename StopStrategy>
     vector<vect> optimizeOnSphere(StopStrategy stopStrategy, FuncT& func, vect p, double r, size_t preHessIters, size_t convergeIters)
     {
         assert(abs(r - p.norm()) < 1e-7);
 
-        auto const theta = makeConstantVect(func.nDims - 1, M_PI / 2);
+        auto shared = share(func);
+        auto onSphere = makeOnSphere(shared, r, p);
 
         vector<vect> path;
         vect momentum;
+        vect step;
+        Evaluation evaluation;
 
         vector<RandomProjection> projs;
         vector<vector<double>> xss, yss;
@@ -139,36 +229,28 @@ namespace optimization
 
         for (size_t iter = 0; ; iter++) {
 //            if (iter % preHessIters == 0 && tryToConverge(stopStrategy, func, p, r, path, convergeIters, iter, true)) {
-            if (iter && iter % preHessIters == 0 && experimentalTryToConverge(stopStrategy, func, p, r, path, convergeIters, iter, false)) {
-                break;
+            if (iter && iter % preHessIters == 0) {
+                bool converged = func.nDims >= KRYLOV_MIN_DIMS
+                                 ? krylovTryToConverge(stopStrategy, shared, p, r, path, convergeIters, iter)
+                                 : experimentalTryToConverge(stopStrategy, shared, p, r, path, convergeIters, iter,
+                                                             false);
+                if (converged)
+                    break;
             }
 
             if (iter > 500) {
                 LOG_WARN("optimizeOnSphere max iteration break");
                 return vector<vect>();
             }
-            auto polar = makePolarWithDirection(func, r, p);
-
-            auto valueGrad = polar.valueGrad(theta);
-            auto value = get<0>(valueGrad);
-            vect grad = get<1>(valueGrad);
-
-            if (iter) {
-                double was = momentum.norm();
-                double factor = sqrt(max(0., angleCosine(momentum, grad) + 1e-2));
-                momentum = factor * momentum + grad / r;
+            double was = momentum.norm();
+            double factor = momentumStepOnSphere(onSphere, r, p, momentum, step, evaluation, iter == 0);
+            if (iter)
                 LOG_DEBUG("factor {:.5f}, old momentum {}, new momentum {}", factor, was ,momentum.norm());
-            }
-            else
-                momentum = grad / r;
-
-            auto lastP = p;
-            p = polar.getInnerFunction().transform(polar.transform(theta - momentum));
             path.push_back(p);
 
-//            if (stopStrategy(iter, p, value, grad, momentum))
+//            if (stopStrategy(iter, p, evaluation.value, evaluation.grad, momentum))
 //                break;
-            stopStrategy(iter, p, value, grad, momentum);
+            stopStrategy(iter, p, evaluation.value, evaluation.grad, momentum);
 
             if (iter % 25 == 0) {
                 xss.clear();
@@ -216,7 +298,7 @@ namespace optimization
         vector<vect> path;
 
         for (size_t iter = 0; iter < preHessIters; iter++) {
-            auto rotation = rotationMatrix(e, p);
+            auto rotation = HouseholderRotation(e, p);
             auto rotated = makeAffineTransfomation(func, rotation);
             auto polar = makePolar(rotated, r);
 
@@ -240,7 +322,7 @@ namespace optimization
                 grad = get<1>(valueGradHess);
                 hess = get<2>(valueGradHess);
 
-                p = rotated.transform(polar.transform(theta - hess.inverse() * grad));
+                p = rotated.transform(polar.transform(theta + newtonStep(hess, grad)));
             }
 
             path.push_back(p);
@@ -258,22 +340,25 @@ namespace optimization
     {
         assert(abs(r - p.norm()) < 1e-7);
 
-        auto const theta = makeConstantVect(func.nDims - 1, M_PI / 2);
+        auto const zero = makeConstantVect(func.nDims - 1, 0.);
+        auto shared = share(func);
+        auto onSphere = makeOnSphere(shared, r, p);
 
         vector<vect> path;
         vect momentum;
+        Evaluation evaluation;
 
         for (size_t iter = 0; ; iter++) {
-            if (iter % preHessIters == 0 && tryToConverge(stopStrategy, func, p, r, path, 5, iter)) {
+            if (iter % preHessIters == 0 && tryToConverge(stopStrategy, shared, p, r, path, 5, iter)) {
                 LOG_ERROR("breaked here");
                 break;
             }
 
-            auto polar = makePolarWithDirection(func, r, p);
+            onSphere.recenter(p);
 
-            auto valueGrad = polar.valueGrad(theta);
-            auto value = get<0>(valueGrad);
-            vect grad = get<1>(valueGrad);
+            onSphere.evaluateInto(zero, 1, evaluation);
+            auto const& value = evaluation.value;
+            auto const& grad = evaluation.grad;
 
             if (iter)
                 momentum = 0.5 * (1 + momentum.dot(grad) / (grad.norm() * momentum.norm())) * momentum + grad;
@@ -281,7 +366,7 @@ namespace optimization
                 momentum = grad;
 
             auto lastP = p;
-            p = polar.getInnerFunction().transform(polar.transform(theta - momentum));
+            p = onSphere.transform(-momentum);
             path.push_back(p);
 
             if (stopStrategy(iter, p, value, grad, p - lastP)) {
@@ -3,12 +3,21 @@
 #include "helper.h"
 #include <typeinfo>
 
+#include "producers/MoleculeProducer.h"
+
 namespace optimization
 {
     //todo: remove all this
 
+    template<bool IsAtomic, typename T, typename... StackTs>
+    struct StackExtractorImpl;
+
+    //walks the wrapper stack down to the molecule backend at its bottom
     template<typename T, typename... StackTs>
-    struct StackExtractor
+    using StackExtractor = StackExtractorImpl<is_base_of<MoleculeProducer, T>::value, T, StackTs...>;
+
+    template<typename T, typename... StackTs>
+    struct StackExtractorImpl<false, T, StackTs...>
     {
         using next_type = decay_t<decltype(((T*) nullptr)->getInnerFunction())>;
         using NextStactExtractor = StackExtractor<next_type, StackTs..., T>;
@@ -27,11 +36,11 @@ namespace optimization
         }
     };
 
-    template<typename... StackTs>
-    struct StackExtractor<GaussianProducer, StackTs...>
+    template<typename T, typename... StackTs>
+    struct StackExtractorImpl<true, T, StackTs...>
     {
         using TupleType = tuple<StackTs const& ...>;
-        using AtomicType = GaussianProducer;
+        using AtomicType = T;
 
         static AtomicType const& extractAtomicFunc(AtomicType const& t)
         {
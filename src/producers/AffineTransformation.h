@@ -3,13 +3,137 @@
 #include "helper.h"
 
 #include "FunctionProducer.h"
+#include "Workspace.h"
 #include "linearAlgebraUtils.h"
 
 template<typename FuncT>
-class AffineTransformation : public FunctionProducer
+class FixValues;
+
+//what AffineTransformation needs from its basis: a dense matrix or a rotation that is never formed
+inline size_t basisCols(matrix const& basis)
+{
+    return (size_t) basis.cols();
+}
+
+inline vect basisApply(matrix const& basis, vect const& x)
+{
+    return basis * x;
+}
+
+inline matrix basisApply(matrix const& basis, matrix const& xs)
+{
+    return basis * xs;
+}
+
+inline vect basisApplyTransposed(matrix const& basis, vect const& grad)
+{
+    return basis.transpose() * grad;
+}
+
+inline matrix basisApplyTransposed(matrix const& basis, matrix const& grads)
+{
+    return basis.transpose() * grads;
+}
+
+inline matrix basisConjugate(matrix const& basis, matrix const& hess)
+{
+    return basis.transpose() * hess * basis;
+}
+
+inline void basisApplyInto(matrix const& basis, vect const& x, vect& to)
+{
+    to.noalias() = basis * x;
+}
+
+inline void basisApplyTransposedInto(matrix const& basis, vect const& grad, vect& to)
+{
+    to.noalias() = basis.transpose() * grad;
+}
+
+inline void basisConjugateInto(matrix const& basis, matrix const& hess, matrix& to)
+{
+    Workspace::Frame frame;
+    auto& hessBasis = frame.getMatrix(0, (size_t) hess.rows(), (size_t) basis.cols());
+    hessBasis.noalias() = hess * basis;
+    to.noalias() = basis.transpose() * hessBasis;
+}
+
+inline matrix basisPseudoInverse(matrix const& basis)
+{
+    return basis.completeOrthogonalDecomposition().pseudoInverse();
+}
+
+inline size_t basisCols(HouseholderRotation const& basis)
+{
+    return basis.nDims();
+}
+
+inline vect basisApply(HouseholderRotation const& basis, vect const& x)
+{
+    return basis.apply(x);
+}
+
+inline matrix basisApply(HouseholderRotation const& basis, matrix const& xs)
+{
+    return basis.apply(xs);
+}
+
+inline vect basisApplyTransposed(HouseholderRotation const& basis, vect const& grad)
+{
+    return basis.applyTransposed(grad);
+}
+
+inline matrix basisApplyTransposed(HouseholderRotation const& basis, matrix const& grads)
+{
+    return basis.applyTransposed(grads);
+}
+
+inline matrix basisConjugate(HouseholderRotation const& basis, matrix const& hess)
+{
+    return basis.conjugate(hess);
+}
+
+inline void basisApplyInto(HouseholderRotation const& basis, vect const& x, vect& to)
+{
+    to = x;
+    basis.applyInPlace(to);
+}
+
+inline void basisApplyTransposedInto(HouseholderRotation const& basis, vect const& grad, vect& to)
+{
+    to = grad;
+    basis.applyTransposedInPlace(to);
+}
+
+inline void basisConjugateInto(HouseholderRotation const& basis, matrix const& hess, matrix& to)
+{
+    Workspace::Frame frame;
+    to = hess;
+    basis.conjugateInPlace(to, frame.getVect(0, basis.nDims()), frame.getVect(1, basis.nDims()));
+}
+
+//a rotation is orthogonal, so its inverse is the transpose
+inline HouseholderRotation basisPseudoInverse(HouseholderRotation const& basis)
+{
+    return basis.transposed();
+}
+
+//inner * outer, the basis of two stacked affine layers
+inline matrix basisCompose(matrix const& inner, matrix const& outer)
+{
+    return inner * outer;
+}
+
+inline matrix basisCompose(HouseholderRotation const& inner, matrix const& outer)
+{
+    return inner.apply(outer);
+}
+
+template<typename FuncT, typename BasisT = matrix>
+class AffineTransformation final : public FunctionProducer
 {
 public:
-    AffineTransformation(FuncT func, vect delta, matrix basis) : FunctionProducer((size_t) basis.cols()),
+    AffineTransformation(FuncT func, vect delta, BasisT basis) : FunctionProducer(basisCols(basis)),
                                                                  mFunc(move(func)), mDelta(move(delta)),
                                                                  mBasis(move(basis))
     { }
@@ -18,28 +142,28 @@ public:
     {
         assert((size_t) x.rows() == nDims);
 
-        return mFunc(transform(x));
+        return statically(mFunc)(transform(x));
     }
 
     vect grad(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        return transformGrad(mFunc.grad(transform(x)));
+        return transformGrad(statically(mFunc).grad(transform(x)));
     }
 
     matrix hess(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        return transformHess(mFunc.hess(transform(x)));
+        return transformHess(statically(mFunc).hess(transform(x)));
     }
 
     tuple<double, vect> valueGrad(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        auto result = mFunc.valueGrad(transform(x));
+        auto result = statically(mFunc).valueGrad(transform(x));
         return make_tuple(get<0>(result), transformGrad(get<1>(result)));
     };
 
@@ -47,15 +171,58 @@ public:
     {
         assert((size_t) x.rows() == nDims);
 
-        auto result = mFunc.valueGradHess(transform(x));
+        auto result = statically(mFunc).valueGradHess(transform(x));
         return make_tuple(get<0>(result), transformGrad(get<1>(result)), transformHess(get<2>(result)));
     };
 
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        assert((size_t) x.rows() == nDims);
+
+        Workspace::Frame frame;
+        auto& transformed = frame.getVect(0, mFunc.nDims);
+        basisApplyInto(mBasis, x, transformed);
+        transformed += mDelta;
+
+        auto& inner = frame.getEvaluation(0, mFunc.nDims);
+        statically(mFunc).evaluateInto(transformed, order, inner);
+
+        result.value = inner.value;
+        if (order >= 1)
+            basisApplyTransposedInto(mBasis, inner.grad, result.grad);
+        if (order >= 2)
+            basisConjugateInto(mBasis, inner.hess, result.hess);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        assert((size_t) x.rows() == nDims);
+        assert((size_t) v.rows() == nDims);
+
+        return transformGrad(statically(mFunc).hessVec(transform(x), basisApply(mBasis, v)));
+    }
+
+    //the whole batch goes through the basis at once: points and gradients as matrix-matrix products
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        assert((size_t) xs.rows() == nDims);
+
+        matrix transformed = basisApply(mBasis, xs);
+        transformed.colwise() += mDelta;
+
+        auto result = statically(mFunc).evaluateBatch(transformed, order);
+        if (order >= 1)
+            result.grads = basisApplyTransposed(mBasis, result.grads);
+        for (auto& hess : result.hesses)
+            hess = transformHess(hess);
+        return result;
+    }
+
     vect transform(vect const& x) const
     {
         assert((size_t) x.rows() == nDims);
 
-        return mBasis * x + mDelta;
+        return basisApply(mBasis, x) + mDelta;
     }
 
     vect fullTransform(vect const& x) const
@@ -67,8 +234,7 @@ public:
     vect backTransform(vect const& x) const
     {
         assert(x.size() == mDelta.size());
-        return mBasis.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(x - mDelta);
-//        return mBasis.inverse() * (x - mDelta);
+        return basisApply(*getPseudoInverse(), vect(x - mDelta));
     }
 
     FuncT const& getInnerFunction() const
@@ -86,44 +252,277 @@ public:
         return mFunc.getFullInnerFunction();
     }
 
-    matrix const& getBasis() const
+    BasisT const& getBasis() const
     {
         return mBasis;
     }
 
+    vect const& getDelta() const
+    {
+        return mDelta;
+    }
+
 private:
     FuncT mFunc;
 
     vect mDelta;
-    matrix mBasis;
+    BasisT mBasis;
+    //computed by the first backTransform, as most layers are never transformed back; copies made after that share it
+    mutable shared_ptr<BasisT const> mPseudoInverse;
+
+    shared_ptr<BasisT const> getPseudoInverse() const
+    {
+        auto pseudoInverse = atomic_load(&mPseudoInverse);
+        if (!pseudoInverse) {
+            pseudoInverse = make_shared<BasisT const>(basisPseudoInverse(mBasis));
+            atomic_store(&mPseudoInverse, pseudoInverse);
+        }
+        return pseudoInverse;
+    }
 
     vect transformGrad(vect const& grad)
     {
-        return mBasis.transpose() * grad;
+        return basisApplyTransposed(mBasis, grad);
     }
 
     matrix transformHess(matrix const& hess)
     {
-        return mBasis.transpose() * hess * mBasis;
+        return basisConjugate(mBasis, hess);
+    }
+};
+
+//a stack of affine and FixValues layers collapsed by AffineFusion or FixFusion. It is evaluated through the single
+//fused layer, while transform, backTransform, getInnerFunction and the other accessors answer as the layer the
+//caller built over its inner function would
+template<typename FusedT, typename LayerT>
+class Fused final : public FunctionProducer
+{
+public:
+    Fused(FusedT fused, LayerT layer) : FunctionProducer(fused.nDims), mFused(move(fused)), mLayer(move(layer))
+    {
+        assert(mLayer.nDims == nDims);
+    }
+
+    double operator()(vect const& x) override
+    {
+        return statically(mFused)(x);
+    }
+
+    vect grad(vect const& x) override
+    {
+        return statically(mFused).grad(x);
+    }
+
+    matrix hess(vect const& x) override
+    {
+        return statically(mFused).hess(x);
+    }
+
+    tuple<double, vect> valueGrad(vect const& x) override
+    {
+        return statically(mFused).valueGrad(x);
+    }
+
+    tuple<double, vect, matrix> valueGradHess(vect const& x) override
+    {
+        return statically(mFused).valueGradHess(x);
+    }
+
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        statically(mFused).evaluateInto(x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        return statically(mFused).hessVec(x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        return statically(mFused).evaluateBatch(xs, order);
+    }
+
+    vect transform(vect const& x) const
+    {
+        return mLayer.transform(x);
+    }
+
+    vect fullTransform(vect const& x) const
+    {
+        return mFused.fullTransform(x);
+    }
+
+    vect backTransform(vect const& x) const
+    {
+        return mLayer.backTransform(x);
+    }
+
+    auto const& getInnerFunction() const
+    {
+        return mLayer.getInnerFunction();
+    }
+
+    decltype(auto) getFullInnerFunction()
+    {
+        return mFused.getFullInnerFunction();
+    }
+
+    decltype(auto) getFullInnerFunction() const
+    {
+        return mFused.getFullInnerFunction();
+    }
+
+    decltype(auto) getBasis() const
+    {
+        return mLayer.getBasis();
+    }
+
+    decltype(auto) getDelta() const
+    {
+        return mLayer.getDelta();
+    }
+
+    decltype(auto) getPositions() const
+    {
+        return mLayer.getPositions();
+    }
+
+    decltype(auto) getValues() const
+    {
+        return mLayer.getValues();
+    }
+
+    //the single layer over the innermost function that the stack is evaluated through
+    FusedT const& getFused() const
+    {
+        return mFused;
+    }
+
+private:
+    FusedT mFused;
+    LayerT mLayer;
+};
+
+template<typename FusedT, typename LayerT>
+auto makeFused(FusedT fused, LayerT layer)
+{
+    return Fused<FusedT, LayerT>(move(fused), move(layer));
+}
+
+//an affine layer over another affine or FixValues layer is collapsed at construction into a single one over the
+//innermost function, so that a stack of any depth costs one product with the basis and one B^T H B per evaluation.
+//fuse gives that single layer and make wraps it into Fused together with the layer the caller asked for. A rotation
+//is the exception: composed into the inner basis it would become a dense matrix, so it stays a layer of its own over
+//the inner one, which costs an extra O(n) per gradient and O(n^2) per Hessian instead
+template<typename FuncT>
+struct AffineFusion
+{
+    template<typename BasisT>
+    static auto fuse(FuncT func, vect delta, BasisT basis)
+    {
+        return AffineTransformation<FuncT, BasisT>(move(func), move(delta), move(basis));
+    }
+
+    template<typename BasisT>
+    static auto make(FuncT func, vect delta, BasisT basis)
+    {
+        return fuse(move(func), move(delta), move(basis));
+    }
+};
+
+template<typename FuncT, typename InnerBasisT>
+struct AffineFusion<AffineTransformation<FuncT, InnerBasisT>>
+{
+    template<typename BasisT>
+    static auto fuse(AffineTransformation<FuncT, InnerBasisT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return AffineTransformation<FuncT>(func.getInnerFunction(), func.transform(delta),
+                                           basisCompose(func.getBasis(), basis));
+    }
+
+    template<typename BasisT>
+    static auto make(AffineTransformation<FuncT, InnerBasisT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return makeFused(fuse(func, delta, basis),
+                         AffineTransformation<AffineTransformation<FuncT, InnerBasisT>, BasisT>(func, delta, basis));
+    }
+
+    static auto make(AffineTransformation<FuncT, InnerBasisT> const& func, vect delta, HouseholderRotation basis)
+    {
+        return AffineTransformation<AffineTransformation<FuncT, InnerBasisT>, HouseholderRotation>(func, move(delta), move(basis));
+    }
+};
+
+template<typename FuncT>
+struct AffineFusion<FixValues<FuncT>>
+{
+    template<typename BasisT>
+    static auto fuse(FixValues<FuncT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return AffineTransformation<FuncT>(func.getInnerFunction(), func.transform(delta),
+                                           basisCompose(func.getBasis(), basis));
+    }
+
+    template<typename BasisT>
+    static auto make(FixValues<FuncT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return makeFused(fuse(func, delta, basis), AffineTransformation<FixValues<FuncT>, BasisT>(func, delta, basis));
+    }
+
+    static auto make(FixValues<FuncT> const& func, vect delta, HouseholderRotation basis)
+    {
+        return AffineTransformation<FixValues<FuncT>, HouseholderRotation>(func, move(delta), move(basis));
+    }
+};
+
+template<typename FusedT, typename LayerT>
+struct AffineFusion<Fused<FusedT, LayerT>>
+{
+    template<typename BasisT>
+    static auto fuse(Fused<FusedT, LayerT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return AffineFusion<FusedT>::fuse(func.getFused(), delta, basis);
+    }
+
+    template<typename BasisT>
+    static auto make(Fused<FusedT, LayerT> const& func, vect const& delta, BasisT const& basis)
+    {
+        return makeFused(fuse(func, delta, basis),
+                         AffineTransformation<Fused<FusedT, LayerT>, BasisT>(func, delta, basis));
+    }
+
+    static auto make(Fused<FusedT, LayerT> const& func, vect delta, HouseholderRotation basis)
+    {
+        return AffineTransformation<Fused<FusedT, LayerT>, HouseholderRotation>(func, move(delta), move(basis));
     }
 };
 
 template<typename FuncT>
 auto makeAffineTransfomation(FuncT&& func, vect delta)
 {
-    return AffineTransformation<decay_t<FuncT>>(forward<FuncT>(func), move(delta), identity(func.nDims));
+    auto basis = identity(func.nDims);
+    return AffineFusion<decay_t<FuncT>>::make(forward<FuncT>(func), move(delta), move(basis));
 }
 
 template<typename FuncT>
 auto makeAffineTransfomation(FuncT&& func, vect delta, matrix const& A)
 {
-    return AffineTransformation<decay_t<FuncT>>(forward<FuncT>(func), move(delta), A);
+    return AffineFusion<decay_t<FuncT>>::make(forward<FuncT>(func), move(delta), A);
 }
 
 template<typename FuncT>
 auto makeAffineTransfomation(FuncT&& func, matrix const& A)
 {
-    return AffineTransformation<decay_t<FuncT>>(forward<FuncT>(func), makeConstantVect((size_t) A.rows(), 0), A);
+    auto delta = makeConstantVect((size_t) A.rows(), 0);
+    return AffineFusion<decay_t<FuncT>>::make(forward<FuncT>(func), move(delta), A);
+}
+
+template<typename FuncT>
+auto makeAffineTransfomation(FuncT&& func, HouseholderRotation rotation)
+{
+    auto delta = makeConstantVect(rotation.nDims(), 0);
+    return AffineFusion<decay_t<FuncT>>::make(forward<FuncT>(func), move(delta), move(rotation));
 }
 
 template<typename FuncT>
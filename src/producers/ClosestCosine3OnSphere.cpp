@@ -40,14 +40,29 @@ matrix ClosestCosine3OnSphere::hess(vect const& x)
 
 tuple<double, vect> ClosestCosine3OnSphere::valueGrad(vect const& x)
 {
-    return FunctionProducer::valueGrad(x);
+    auto result = evaluate(x, 1);
+    return make_tuple(result.value, move(result.grad));
 };
 
 tuple<double, vect, matrix> ClosestCosine3OnSphere::valueGradHess(vect const& x)
 {
-    return FunctionProducer::valueGradHess(x);
+    auto result = evaluate(x, 2);
+    return make_tuple(result.value, move(result.grad), move(result.hess));
 };
 
+void ClosestCosine3OnSphere::evaluateInto(vect const& x, size_t order, Evaluation& result)
+{
+    size_t closest = getClosest(x);
+    if (closest != (size_t) -1)
+        return mSupplements[closest].evaluateInto(x, order, result);
+
+    result.value = 0.;
+    if (order >= 1)
+        result.grad.setZero(nDims);
+    if (order >= 2)
+        result.hess.setZero(nDims, nDims);
+}
+
 size_t ClosestCosine3OnSphere::getClosest(vect const& x)
 {
     auto closest = (size_t) -1;
@@ -3,9 +3,10 @@
 #include "helper.h"
 
 #include "FunctionProducer.h"
+#include "AffineTransformation.h"
 
 template<typename FuncT>
-class FixValues : public FunctionProducer
+class FixValues final : public FunctionProducer
 {
 public:
     FixValues(FuncT func, vector<size_t> poss, vector<double> const& vals)
@@ -20,28 +21,28 @@ public:
     {
         assert((size_t) x.rows() == nDims);
 
-        return mFunc(transform(x));
+        return statically(mFunc)(transform(x));
     }
 
     vect grad(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        return transformGrad(mFunc.grad(transform(x)));
+        return transformGrad(statically(mFunc).grad(transform(x)));
     }
 
     matrix hess(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        return transformHess(mFunc.hess(transform(x)));
+        return transformHess(statically(mFunc).hess(transform(x)));
     };
 
     tuple<double, vect> valueGrad(vect const& x) override
     {
         assert((size_t) x.rows() == nDims);
 
-        auto result = mFunc.valueGrad(transform(x));
+        auto result = statically(mFunc).valueGrad(transform(x));
         return make_tuple(get<0>(result), transformGrad(get<1>(result)));
     };
 
@@ -49,18 +50,66 @@ public:
     {
         assert((size_t) x.rows() == nDims);
 
-        auto result = mFunc.valueGradHess(transform(x));
+        auto result = statically(mFunc).valueGradHess(transform(x));
         return make_tuple(get<0>(result), transformGrad(get<1>(result)), transformHess(get<2>(result)));
     };
 
-    vect transform(vect const& from) const
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        assert((size_t) x.rows() == nDims);
+
+        Workspace::Frame frame;
+        auto& transformed = frame.getVect(0, mFunc.nDims);
+        transformInto(x, transformed);
+
+        auto& inner = frame.getEvaluation(0, mFunc.nDims);
+        statically(mFunc).evaluateInto(transformed, order, inner);
+
+        result.value = inner.value;
+        if (order >= 1)
+            transformGradInto(inner.grad, result.grad);
+        if (order >= 2)
+            transformHessInto(inner.hess, result.hess);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
     {
-        vect to(nDims + mPoss.size());
+        assert((size_t) x.rows() == nDims);
+        assert((size_t) v.rows() == nDims);
+
+        return transformGrad(statically(mFunc).hessVec(transform(x), transformDirection(v)));
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        assert((size_t) xs.rows() == nDims);
+
+        matrix transformed(mFunc.nDims, xs.cols());
         for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
             if (j < mPoss.size() && i == mPoss[j])
-                to(i) = mVals[j++];
+                transformed.row(i).setConstant(mVals[j++]);
             else
-                to(i) = from(k++);
+                transformed.row(i) = xs.row(k++);
+
+        auto result = statically(mFunc).evaluateBatch(transformed, order);
+        if (order >= 1) {
+            matrix grads(nDims, xs.cols());
+            for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
+                if (j < mPoss.size() && i == mPoss[j])
+                    j++;
+                else
+                    grads.row(k++) = result.grads.row(i);
+            result.grads = move(grads);
+        }
+        for (auto& hess : result.hesses)
+            hess = transformHess(hess);
+        return result;
+    }
+
+    vect transform(vect const& from) const
+    {
+        vect to;
+        transformInto(from, to);
         return to;
     }
 
@@ -88,6 +137,28 @@ public:
         return mFunc;
     }
 
+    //the columns of the identity at the free positions: transform(x) is getBasis() * x + transform(0)
+    matrix getBasis() const
+    {
+        matrix basis = matrix::Zero(mFunc.nDims, nDims);
+        for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
+            if (j < mPoss.size() && i == mPoss[j])
+                j++;
+            else
+                basis(i, k++) = 1.;
+        return basis;
+    }
+
+    vector<size_t> const& getPositions() const
+    {
+        return mPoss;
+    }
+
+    vector<double> const& getValues() const
+    {
+        return mVals;
+    }
+
     auto const& getFullInnerFunction() const
     {
         return mFunc.getFullInnerFunction();
@@ -98,20 +169,54 @@ private:
     vector<size_t> mPoss;
     vector<double> mVals;
 
+    vect transformDirection(vect const& from) const
+    {
+        vect to(mFunc.nDims);
+        for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
+            if (j < mPoss.size() && i == mPoss[j])
+                to(i) = 0., j++;
+            else
+                to(i) = from(k++);
+        return to;
+    }
+
+    void transformInto(vect const& from, vect& to) const
+    {
+        to.resize(mFunc.nDims);
+        for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
+            if (j < mPoss.size() && i == mPoss[j])
+                to(i) = mVals[j++];
+            else
+                to(i) = from(k++);
+    }
+
     vect transformGrad(vect const& grad)
     {
-        vect transformed(nDims);
+        vect transformed;
+        transformGradInto(grad, transformed);
+        return transformed;
+    }
+
+    void transformGradInto(vect const& grad, vect& transformed) const
+    {
+        transformed.resize(nDims);
         for (size_t i = 0, j = 0, k = 0; i < mFunc.nDims; i++)
             if (j < mPoss.size() && i == mPoss[j])
                 j++;
             else
                 transformed(k++) = grad(i);
-        return transformed;
     }
 
     matrix transformHess(matrix const& hess)
     {
-        matrix transformed(nDims, nDims);
+        matrix transformed;
+        transformHessInto(hess, transformed);
+        return transformed;
+    }
+
+    void transformHessInto(matrix const& hess, matrix& transformed) const
+    {
+        transformed.resize(nDims, nDims);
         for (size_t i1 = 0, j1 = 0, k1 = 0; i1 < mFunc.nDims; i1++)
             if (j1 < mPoss.size() && i1 == mPoss[j1])
                 j1++;
@@ -124,14 +229,106 @@ private:
                     }
                 k1++;
             }
-        return transformed;
+    }
+};
+
+//like AffineFusion: fixing values of an affine layer gives a single affine layer, and fixing values of a FixValues
+//layer merges both into one
+template<typename FuncT>
+struct FixFusion
+{
+    static auto fuse(FuncT func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        return FixValues<FuncT>(move(func), poss, vals);
+    }
+
+    static auto make(FuncT func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        return fuse(move(func), poss, vals);
+    }
+};
+
+template<typename FuncT, typename BasisT>
+struct FixFusion<AffineTransformation<FuncT, BasisT>>
+{
+    static auto fuse(AffineTransformation<FuncT, BasisT> const& func, vector<size_t> const& poss,
+                     vector<double> const& vals)
+    {
+        return fuseFixed(FixValues<AffineTransformation<FuncT, BasisT>>(func, poss, vals));
+    }
+
+    static auto make(AffineTransformation<FuncT, BasisT> const& func, vector<size_t> const& poss,
+                     vector<double> const& vals)
+    {
+        auto fixed = FixValues<AffineTransformation<FuncT, BasisT>>(func, poss, vals);
+        return makeFused(fuseFixed(fixed), move(fixed));
+    }
+
+private:
+    static auto fuseFixed(FixValues<AffineTransformation<FuncT, BasisT>> const& fixed)
+    {
+        return AffineFusion<AffineTransformation<FuncT, BasisT>>::fuse(
+           fixed.getInnerFunction(), fixed.transform(makeConstantVect(fixed.nDims, 0.)), fixed.getBasis());
+    }
+};
+
+template<typename FuncT>
+struct FixFusion<FixValues<FuncT>>
+{
+    static auto fuse(FixValues<FuncT> const& func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        auto const& innerPoss = func.getPositions();
+        auto const& innerVals = func.getValues();
+
+        //positions of the inner function that stay free, the coordinates poss refers to
+        vector<size_t> free;
+        for (size_t i = 0, j = 0; i < func.getInnerFunction().nDims; i++)
+            if (j < innerPoss.size() && i == innerPoss[j])
+                j++;
+            else
+                free.push_back(i);
+
+        vector<pair<size_t, double>> merged;
+        for (size_t i = 0; i < innerPoss.size(); i++)
+            merged.emplace_back(innerPoss[i], innerVals[i]);
+        for (size_t i = 0; i < poss.size(); i++)
+            merged.emplace_back(free[poss[i]], vals[i]);
+        sort(merged.begin(), merged.end());
+
+        vector<size_t> mergedPoss;
+        vector<double> mergedVals;
+        for (auto const& posVal : merged) {
+            mergedPoss.push_back(posVal.first);
+            mergedVals.push_back(posVal.second);
+        }
+
+        return FixValues<FuncT>(func.getInnerFunction(), move(mergedPoss), mergedVals);
+    }
+
+    static auto make(FixValues<FuncT> const& func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        return makeFused(fuse(func, poss, vals), FixValues<FixValues<FuncT>>(func, poss, vals));
+    }
+};
+
+template<typename FusedT, typename LayerT>
+struct FixFusion<Fused<FusedT, LayerT>>
+{
+    static auto fuse(Fused<FusedT, LayerT> const& func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        return FixFusion<FusedT>::fuse(func.getFused(), poss, vals);
+    }
+
+    static auto make(Fused<FusedT, LayerT> const& func, vector<size_t> const& poss, vector<double> const& vals)
+    {
+        return makeFused(fuse(func, poss, vals), FixValues<Fused<FusedT, LayerT>>(func, poss, vals));
     }
 };
 
 template<typename FuncT>
 auto fix(FuncT&& func, vector<size_t> const& poss, vector<double> const& vals)
 {
-    return FixValues<decay_t<FuncT>>(forward<FuncT>(func), poss, vals);
+    return FixFusion<decay_t<FuncT>>::make(forward<FuncT>(func), poss, vals);
 };
 
 template<typename FuncT>
@@ -1,5 +1,7 @@
 #include "FunctionProducer.h"
 
+#include <atomic>
+
 tuple<double, vect> FunctionProducer::valueGrad(vect const& x)
 {
     return make_tuple((*this)(x), grad(x));
@@ -8,4 +10,69 @@ tuple<double, vect> FunctionProducer::valueGrad(vect const& x)
 tuple<double, vect, matrix> FunctionProducer::valueGradHess(vect const& x)
 {
     return make_tuple((*this)(x), grad(x), hess(x));
-}
\ No newline at end of file
+}
+
+Evaluation FunctionProducer::evaluate(vect const& x, size_t order)
+{
+    Evaluation result;
+    evaluateInto(x, order, result);
+    return result;
+}
+
+void FunctionProducer::evaluateInto(vect const& x, size_t order, Evaluation& result)
+{
+    if (order >= 2)
+        tie(result.value, result.grad, result.hess) = valueGradHess(x);
+    else if (order == 1)
+        tie(result.value, result.grad) = valueGrad(x);
+    else
+        result.value = (*this)(x);
+}
+
+vect FunctionProducer::hessVec(vect const& x, vect const& v)
+{
+    return hess(x) * v;
+}
+
+BatchResult FunctionProducer::evaluateBatch(matrix const& xs, size_t order)
+{
+    assert((size_t) xs.rows() == nDims);
+
+    BatchResult result;
+    result.values.resize(xs.cols());
+    if (order >= 1)
+        result.grads.resize(nDims, xs.cols());
+
+    Evaluation evaluation;
+    for (long i = 0; i < xs.cols(); i++) {
+        evaluateInto(xs.col(i), order, evaluation);
+        result.values(i) = evaluation.value;
+        if (order >= 1)
+            result.grads.col(i) = evaluation.grad;
+        if (order >= 2)
+            result.hesses.push_back(evaluation.hess);
+    }
+
+    return result;
+}
+
+void FunctionProducer::collectLinearTerms(double factor, vector<LinearTerm>& terms)
+{
+    terms.push_back({factor, this});
+}
+
+size_t FunctionProducer::getNodeId() const
+{
+    return mNodeId;
+}
+
+void FunctionProducer::renewNodeId()
+{
+    mNodeId = nextNodeId();
+}
+
+size_t FunctionProducer::nextNodeId()
+{
+    static atomic<size_t> counter(0);
+    return counter++;
+}
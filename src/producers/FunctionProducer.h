@@ -2,10 +2,36 @@
 
 #include "helper.h"
 
+//values, gradients and Hessians at the columns of a matrix of points. Gradients are the columns of grads and are
+//only filled for order >= 1, Hessians only for order 2
+struct BatchResult
+{
+    vect values;
+    matrix grads;
+    vector<matrix> hesses;
+};
+
+//value, gradient and Hessian at one point; grad is only filled for order >= 1, hess only for order 2
+struct Evaluation
+{
+    double value;
+    vect grad;
+    matrix hess;
+};
+
+class FunctionProducer;
+
+//a producer scaled by factor, one leaf of a flattened Sum / Difference / MultipliedByConstant expression
+struct LinearTerm
+{
+    double factor;
+    FunctionProducer* func;
+};
+
 class FunctionProducer
 {
 public:
-    FunctionProducer(size_t nDims) : nDims(nDims)
+    FunctionProducer(size_t nDims) : nDims(nDims), mNodeId(nextNodeId())
     { }
 
     virtual ~FunctionProducer() = default;
@@ -14,8 +40,166 @@ public:
     virtual vect      grad(vect const& x) = 0;
     virtual matrix hess(vect const& x) = 0;
 
+    //the definitions of these two are the fallback for leaves whose derivatives share no work, and call operator(),
+    //grad and hess one by one. They cannot go through evaluateInto, whose default dispatches back to them
     virtual tuple<double, vect> valueGrad(vect const& x) = 0;
     virtual tuple<double, vect, matrix> valueGradHess(vect const& x) = 0;
 
+    //everything up to the given derivative order from a single call, so backends run one job of the matching kind
+    Evaluation evaluate(vect const& x, size_t order);
+
+    //evaluate into a caller-owned result whose buffers are reused when they already have the right sizes. Wrappers
+    //take their temporaries from the thread's Workspace, so repeated calls on the same stack do not allocate
+    virtual void evaluateInto(vect const& x, size_t order, Evaluation& result);
+
+    //hess(x) * v; producers that can do better than building the whole Hessian override it
+    virtual vect hessVec(vect const& x, vect const& v);
+
+    //evaluates every column of xs up to the given derivative order; backends may run the points concurrently
+    virtual BatchResult evaluateBatch(matrix const& xs, size_t order);
+
+    //appends this producer scaled by factor; producer algebra appends its operands instead
+    virtual void collectLinearTerms(double factor, vector<LinearTerm>& terms);
+
+    //copies keep the id of the producer they were made from, as they compute the same function. Setters that change
+    //what a copy computes give it a new id, so that it is not merged with the original
+    size_t getNodeId() const;
+
     const size_t nDims;
+
+protected:
+    void renewNodeId();
+
+private:
+    size_t mNodeId;
+
+    static size_t nextNodeId();
+};
+
+//the static side of the producer protocol. Wrappers hold their inner producers by value, so the concrete type is
+//known at compile time; calls made through statically(mFunc) are qualified with it, bind without the vtable and can
+//be inlined across the layers of a stack. Only a final class can be qualified safely: an object of a class that is
+//not final may be of a derived type overriding the call, so for such classes statically dispatches through the
+//vtable as usual. FunctionProducer stays the type-erased interface for callers holding a FunctionProducer&, such as
+//the merged leaves of LinearTerms
+template<typename FuncT, bool = is_final<FuncT>::value>
+class StaticProducer;
+
+template<typename FuncT>
+class StaticProducer<FuncT, true>
+{
+public:
+    explicit StaticProducer(FuncT& func) : mFunc(func)
+    { }
+
+    double operator()(vect const& x) const
+    {
+        return mFunc.FuncT::operator()(x);
+    }
+
+    vect grad(vect const& x) const
+    {
+        return mFunc.FuncT::grad(x);
+    }
+
+    matrix hess(vect const& x) const
+    {
+        return mFunc.FuncT::hess(x);
+    }
+
+    tuple<double, vect> valueGrad(vect const& x) const
+    {
+        return mFunc.FuncT::valueGrad(x);
+    }
+
+    tuple<double, vect, matrix> valueGradHess(vect const& x) const
+    {
+        return mFunc.FuncT::valueGradHess(x);
+    }
+
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) const
+    {
+        mFunc.FuncT::evaluateInto(x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) const
+    {
+        return mFunc.FuncT::hessVec(x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) const
+    {
+        return mFunc.FuncT::evaluateBatch(xs, order);
+    }
+
+    void collectLinearTerms(double factor, vector<LinearTerm>& terms) const
+    {
+        mFunc.FuncT::collectLinearTerms(factor, terms);
+    }
+
+private:
+    FuncT& mFunc;
+};
+
+template<typename FuncT>
+class StaticProducer<FuncT, false>
+{
+public:
+    explicit StaticProducer(FuncT& func) : mFunc(func)
+    { }
+
+    double operator()(vect const& x) const
+    {
+        return mFunc(x);
+    }
+
+    vect grad(vect const& x) const
+    {
+        return mFunc.grad(x);
+    }
+
+    matrix hess(vect const& x) const
+    {
+        return mFunc.hess(x);
+    }
+
+    tuple<double, vect> valueGrad(vect const& x) const
+    {
+        return mFunc.valueGrad(x);
+    }
+
+    tuple<double, vect, matrix> valueGradHess(vect const& x) const
+    {
+        return mFunc.valueGradHess(x);
+    }
+
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) const
+    {
+        mFunc.evaluateInto(x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) const
+    {
+        return mFunc.hessVec(x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) const
+    {
+        return mFunc.evaluateBatch(xs, order);
+    }
+
+    void collectLinearTerms(double factor, vector<LinearTerm>& terms) const
+    {
+        mFunc.collectLinearTerms(factor, terms);
+    }
+
+private:
+    FuncT& mFunc;
 };
+
+template<typename FuncT>
+StaticProducer<FuncT> statically(FuncT& func)
+{
+    static_assert(is_base_of<FunctionProducer, FuncT>::value, "statically is for producers held by concrete type");
+    return StaticProducer<FuncT>(func);
+}
@@ -1,5 +1,7 @@
 #include "GaussianProducer.h"
 
+#include "linearAlgebraUtils.h"
+
 string const GAUSSIAN_HEADER = "%RWF={0}rwf\n"
    "%Int={0}int\n"
    "%D2E={0}d2e\n"
@@ -8,52 +10,186 @@ string const GAUSSIAN_HEADER = "%RWF={0}rwf\n"
    "%chk={0}chk\n"
    "%nproc={2}\n"
    "%mem={3}mb\n"
-   "# B3lyp/3-21g nosym {1}\n"
+   "# {4} nosym FormCheck=All {1}{5}\n"
    "\n"
    "\n"
    "0 1";
 
+//Gaussian appends .chk to the %chk name above
+string const CHECKPOINT_FILE = "chk.chk";
+
+string const LEVEL_OF_THEORY = "B3lyp/3-21g";
+
 string const SCF_METHOD = "scf";
 string const FORCE_METHOD = "force";
 //string const FORCE_METHOD = "freq=ReadFC";
 string const HESS_METHOD = "freq";
 string const OPT_METHOD = "FOpt";
 
-GaussianProducer::GaussianProducer(vector<size_t> charges, size_t nProc, size_t mem) : FunctionProducer(
-   charges.size() * 3), mCharges(move(charges)), mNProc(nProc), mMem(mem)
+size_t methodOrder(string const& method)
+{
+    if (method == HESS_METHOD)
+        return 2;
+    if (method == FORCE_METHOD)
+        return 1;
+    return 0;
+}
+
+GaussianException::GaussianException(Reason reason, string const& details) : mReason(reason), mMessage(details)
+{ }
+
+char const* GaussianException::what() const noexcept
+{
+    return mMessage.c_str();
+}
+
+GaussianException::Reason GaussianException::getReason() const
+{
+    return mReason;
+}
+
+GaussianProducer::GaussianProducer(vector<size_t> charges, size_t nProc, size_t mem) : MoleculeProducer(
+   move(charges)), mNProc(nProc), mMem(mem), mHessianMode(HessianMode::Analytic), mStep(FINITE_DIFFERENCE_STEP),
+   mCache(make_shared<EvaluationCache>()),
+   mPool(JobPool::global()), mScratch(ScratchManager::global()),
+   mCheckpoints(make_shared<CheckpointHistory>(mScratch->acquire())),
+   mLauncher(ProcessLauncher::global()), mTimings(make_shared<JobTimings>()), mUsage(BackendUsage::global())
 {}
 
 double GaussianProducer::operator()(vect const& x)
 {
     assert((size_t) x.rows() == nDims);
 
-    auto result = runGaussian(x, SCF_METHOD);
-    return parseValue(result);
+    return calculate(x, SCF_METHOD).value;
 }
 
 tuple<double, vect> GaussianProducer::valueGrad(vect const& x)
 {
     assert((size_t) x.rows() == nDims);
 
-    auto result = runGaussian(x, FORCE_METHOD);
+    auto result = calculate(x, FORCE_METHOD);
+    return make_tuple(result.value, *result.grad);
+}
+
+tuple<double, vect, matrix> GaussianProducer::valueGradHess(vect const& x)
+{
+    assert((size_t) x.rows() == nDims);
+
+    if (mHessians && HessianReuseScope::enabled())
+        if (auto base = mHessians->nearest(x)) {
+            auto result = calculate(x, FORCE_METHOD);
+            if (auto hess = mHessians->update(*base, x, *result.grad)) {
+                if (base->x != x)
+                    mHessians->add({x, *result.grad, *hess, base->updates + 1});
+                return make_tuple(result.value, *result.grad, *hess);
+            }
+        }
 
-    auto value = parseValue(result);
-    auto grad = parseGrad(result);
+    auto result = calculateHessian(x);
+    if (mHessians)
+        mHessians->add({x, *result.grad, *result.hess, 0});
+    return make_tuple(result.value, *result.grad, *result.hess);
+}
 
-    return make_tuple(value, grad);
+//central difference of two concurrent force jobs along v, unless a Hessian at x is already known
+vect GaussianProducer::hessVec(vect const& x, vect const& v)
+{
+    assert((size_t) x.rows() == nDims);
+    assert((size_t) v.rows() == nDims);
+
+    if (auto cached = mCache->find(x, 2))
+        return *cached->hess * v;
+
+    double norm = v.norm();
+    if (norm == 0)
+        return makeConstantVect(nDims, 0.);
+
+    vect step = v * (mStep / norm);
+    auto plus = submit(x + step, FORCE_METHOD);
+    auto minus = submit(x - step, FORCE_METHOD);
+    return (*mPool->await(plus).grad - *mPool->await(minus).grad) * (norm / (2 * mStep));
 }
 
-tuple<double, vect, matrix> GaussianProducer::valueGradHess(vect const& x)
+//every point is an independent job, so the whole batch is submitted to the pool before the first one is awaited
+BatchResult GaussianProducer::evaluateBatch(matrix const& xs, size_t order)
+{
+    assert((size_t) xs.rows() == nDims);
+
+    BatchResult result;
+    result.values.resize(xs.cols());
+    if (order >= 1)
+        result.grads.resize(nDims, xs.cols());
+
+    if (order >= 2) {
+        vector<future<tuple<double, vect, matrix>>> jobs;
+        for (long i = 0; i < xs.cols(); i++)
+            jobs.push_back(asyncValueGradHess(xs.col(i)));
+
+        for (long i = 0; i < xs.cols(); i++) {
+            auto valueGradHess = mPool->await(jobs[i]);
+            result.values(i) = get<0>(valueGradHess);
+            result.grads.col(i) = get<1>(valueGradHess);
+            result.hesses.push_back(get<2>(valueGradHess));
+        }
+    } else {
+        vector<future<GaussianResult>> jobs;
+        for (long i = 0; i < xs.cols(); i++)
+            jobs.push_back(submit(xs.col(i), order ? FORCE_METHOD : SCF_METHOD));
+
+        for (long i = 0; i < xs.cols(); i++) {
+            auto calculated = mPool->await(jobs[i]);
+            result.values(i) = calculated.value;
+            if (order)
+                result.grads.col(i) = *calculated.grad;
+        }
+    }
+
+    return result;
+}
+
+tuple<double, vect, matrix> GaussianProducer::finiteDifferenceValueGradHess(vect const& x, matrix const& basis)
 {
     assert((size_t) x.rows() == nDims);
+    assert((size_t) basis.rows() == nDims);
 
-    auto result = runGaussian(x, HESS_METHOD);
+    auto result = finiteDifferenceHessian(x, calculate(x, FORCE_METHOD), basis);
+    return make_tuple(result.value, *result.grad, *result.hess);
+}
+
+tuple<double, vect, matrix> GaussianProducer::finiteDifferenceValueGradHess(vect const& x)
+{
+    return finiteDifferenceValueGradHess(x, translationFreeBasis(mCharges.size()));
+}
 
-    auto value = parseValue(result);
-    auto grad = parseGrad(result);
-    auto hess = parseHess(result);
+future<GaussianResult> GaussianProducer::submit(vect const& x, string const& method)
+{
+    assert((size_t) x.rows() == nDims);
+
+    auto producer = *this;
+    return mPool->submit(mNProc, [producer, x, method, stage = UsageStage::current()]() mutable {
+        UsageStage scope(stage);
+        return producer.calculate(x, method);
+    });
+}
+
+future<tuple<double, vect>> GaussianProducer::asyncValueGrad(vect const& x)
+{
+    auto producer = *this;
+    return mPool->submit(mNProc, [producer, x, stage = UsageStage::current()]() mutable {
+        UsageStage scope(stage);
+        return producer.valueGrad(x);
+    });
+}
 
-    return make_tuple(value, grad, hess);
+future<tuple<double, vect, matrix>> GaussianProducer::asyncValueGradHess(vect const& x)
+{
+    auto producer = *this;
+    return mPool->submit(mNProc, [producer, x, stage = UsageStage::current(),
+                                  reuse = HessianReuseScope::enabled()]() mutable {
+        UsageStage scope(stage);
+        HessianReuseScope reuseScope(reuse);
+        return producer.valueGradHess(x);
+    });
 }
 
 vect GaussianProducer::grad(vect const& x)
@@ -66,141 +202,314 @@ matrix GaussianProducer::hess(vect const& x)
     return get<2>(valueGradHess(x));
 };
 
-ifstream GaussianProducer::runGaussian(vect const& x, string const& method) const
+GaussianResult GaussianProducer::calculate(vect const& x, string const& method)
 {
-    auto fileMask = createInputFile(x, method);
+    bool missed = false;
+    auto result = mCache->get(x, methodOrder(method), [&] {
+        missed = true;
+        if (mStore)
+            if (auto stored = mStore->find(mCharges, x, methodOrder(method), LEVEL_OF_THEORY)) {
+                mUsage->recordStoreHit(UsageStage::current(), method);
+                return *stored;
+            }
+
+        auto scratch = mScratch->acquire();
+        auto checkpoint = scratch.getPath() + CHECKPOINT_FILE;
+        auto guess = mCheckpoints->nearest(x);
+        if (guess && !guess->copyTo(checkpoint))
+            guess = nullptr;
+
+        try {
+            runGaussian(scratch.getPath(), x, method, (bool) guess);
+        } catch (GaussianException const& exc) {
+            if (!guess || exc.getReason() != GaussianException::Reason::NonzeroExit)
+                throw;
+            LOG_WARN("{} job failed from a read guess, retrying from scratch", method);
+            remove(checkpoint.c_str());
+            runGaussian(scratch.getPath(), x, method, false);
+        }
+        auto result = parseResult(scratch.getPath() + "Test.FChk", method);
+        mCheckpoints->add(x, checkpoint);
 
-    if (system(format("GAUSS_SCRDIR={0} mg09D {0}input {0}output > /dev/null", fileMask).c_str())) {
-        throw GaussianException(this_thread::get_id());
-    }
+        if (mStore)
+            mStore->append(mCharges, x, methodOrder(method), LEVEL_OF_THEORY, result);
+
+        return result;
+    });
 
-    if (system(format("formchk {}chk.chk > /dev/null", fileMask).c_str())) {
-        throw GaussianException(this_thread::get_id());
+    if (!missed)
+        mUsage->recordCacheHit(UsageStage::current(), method);
+    return result;
+}
+
+GaussianResult GaussianProducer::calculateHessian(vect const& x)
+{
+    if (!prefersFiniteDifferences())
+        return calculate(x, HESS_METHOD);
+
+    //the center gradient has to be in the cache before the Hessian entry for the same geometry is claimed
+    auto center = calculate(x, FORCE_METHOD);
+    bool missed = false;
+    auto result = mCache->get(x, 2, [&] {
+        missed = true;
+        if (mStore)
+            if (auto stored = mStore->find(mCharges, x, 2, LEVEL_OF_THEORY)) {
+                mUsage->recordStoreHit(UsageStage::current(), HESS_METHOD);
+                return *stored;
+            }
+
+        return finiteDifferenceHessian(x, center, translationFreeBasis(mCharges.size()));
+    });
+
+    if (!missed)
+        mUsage->recordCacheHit(UsageStage::current(), HESS_METHOD);
+    return result;
+}
+
+GaussianResult GaussianProducer::finiteDifferenceHessian(vect const& x, GaussianResult const& center,
+                                                         matrix const& basis)
+{
+    auto displaced = *this;
+    displaced.setNProc(1);
+
+    vector<future<GaussianResult>> plus, minus;
+    for (long i = 0; i < basis.cols(); i++) {
+        plus.push_back(displaced.submit(x + mStep * basis.col(i), FORCE_METHOD));
+        minus.push_back(displaced.submit(x - mStep * basis.col(i), FORCE_METHOD));
     }
 
-    return ifstream(fileMask + "chk.fchk");
+    matrix columns(nDims, basis.cols());
+    for (long i = 0; i < basis.cols(); i++)
+        columns.col(i) = (*mPool->await(plus[i]).grad - *mPool->await(minus[i]).grad) / (2 * mStep);
+
+    matrix projected = basis.transpose() * columns;
+    projected = .5 * (projected + projected.transpose()).eval();
+    matrix hess = columns * basis.transpose();
+    hess += hess.transpose().eval();
+    hess -= basis * projected * basis.transpose();
+
+    return GaussianResult{center.value, center.grad, hess};
 }
 
-vect GaussianProducer::optimize(vect const& structure) const
+//Auto mode takes analytic Hessians until a freq job is timed, then finite differences of 2 (nDims - 3) force jobs
+//until a single core force job is timed, then whichever the two mean times predict to finish first
+bool GaussianProducer::prefersFiniteDifferences() const
 {
-    auto result = runGaussian(structure, OPT_METHOD);
-    return parseStructure(result);
+    if (mHessianMode != HessianMode::Auto)
+        return mHessianMode == HessianMode::FiniteDifference;
+
+    auto analytic = mTimings->mean(HESS_METHOD, mNProc);
+    if (!analytic)
+        return false;
+    auto force = mTimings->mean(FORCE_METHOD, 1);
+    if (!force)
+        return true;
+
+    size_t jobs = 2 * (nDims - 3);
+    size_t waves = (jobs + mPool->getCores() - 1) / mPool->getCores();
+    return waves * *force < *analytic;
 }
 
-vector<size_t> const& GaussianProducer::getCharges() const
+GaussianResult GaussianProducer::parseResult(string const& fchkPath, string const& method) const
 {
-    return mCharges;
+    try {
+        return parseFchk(fchkPath, nDims, methodOrder(method), MAGIC_CONSTANT);
+    } catch (runtime_error const& exc) {
+        LOG_ERROR("{}", exc.what());
+        throw GaussianException(GaussianException::Reason::ParseFailure, exc.what());
+    }
 }
 
-vect GaussianProducer::transform(vect from) const
+void GaussianProducer::runGaussian(string const& directory, vect const& x, string const& method, bool guessRead) const
 {
-    return from;
+    createInputFile(directory, x, method, guessRead ? " guess=read" : "");
+
+    ProcessResult result;
+    try {
+        result = mLauncher->run({"mg09D", "input", "output"}, directory, {{"GAUSS_SCRDIR", directory}},
+                                directory + "stderr");
+    } catch (runtime_error const& exc) {
+        LOG_ERROR("{}", exc.what());
+        mUsage->recordFailure(UsageStage::current(), method);
+        throw GaussianException(GaussianException::Reason::LaunchFailure, exc.what());
+    }
+
+    if (result.succeeded()) {
+        mTimings->record(method, mNProc, result.wallTime);
+        mUsage->recordJob(UsageStage::current(), method, result.wallTime, result.cpuTime);
+        return;
+    }
+    mUsage->recordFailure(UsageStage::current(), method);
+
+    string message;
+    GaussianException::Reason reason;
+    switch (result.status) {
+        case ProcessResult::Status::TimedOut:
+            reason = GaussianException::Reason::Timeout;
+            message = format("{} job timed out after {:.1f}s", method, result.wallTime);
+            break;
+        case ProcessResult::Status::Cancelled:
+            reason = GaussianException::Reason::Cancelled;
+            message = format("{} job was cancelled", method);
+            break;
+        case ProcessResult::Status::Signaled:
+            reason = GaussianException::Reason::Signaled;
+            message = format("{} job was killed by signal {}", method, result.code);
+            break;
+        default:
+            reason = GaussianException::Reason::NonzeroExit;
+            message = format("{} job exited with code {}", method, result.code);
+    }
+    if (!result.stderrTail.empty())
+        message += ": " + result.stderrTail;
+
+    LOG_ERROR("{}", message);
+    throw GaussianException(reason, message);
 }
 
-vect GaussianProducer::fullTransform(vect from) const
+vect GaussianProducer::optimize(vect const& structure) const
 {
-    return from;
+    auto scratch = mScratch->acquire();
+    runGaussian(scratch.getPath(), structure, OPT_METHOD, false);
+    try {
+        return parseFchkStructure(scratch.getPath() + "Test.FChk", nDims, MAGIC_CONSTANT);
+    } catch (runtime_error const& exc) {
+        LOG_ERROR("{}", exc.what());
+        throw GaussianException(GaussianException::Reason::ParseFailure, exc.what());
+    }
 }
 
-void GaussianProducer::setGaussianNProc(size_t nProc)
+void GaussianProducer::setNProc(size_t nProc)
 {
     mNProc = nProc;
 }
 
-void GaussianProducer::setGaussianMem(size_t mem)
+void GaussianProducer::setMem(size_t mem)
 {
     mMem = mem;
 }
 
-GaussianProducer const& GaussianProducer::getFullInnerFunction() const
+string GaussianProducer::getStatistics() const
 {
-    return *this;
+    auto scratch = mScratch->getUsage();
+    auto statistics = format("Evaluation cache: {} hits, {} coalesced, {} misses\n"
+                             "Scratch: {} jobs, {} MB total, {} MB peak per job\n"
+                             "SCF warm starts: {}", mCache->hits(), mCache->coalesced(), mCache->misses(),
+                             scratch.jobs, scratch.totalBytes >> 20, scratch.peakBytes >> 20,
+                             mCheckpoints->getWarmStarts());
+    if (mHessians)
+        statistics += format("\nHessians: {} exact, {} updated", mHessians->getExactHessians(),
+                             mHessians->getUpdatedHessians());
+    if (mHessianMode != HessianMode::Analytic)
+        statistics += format("\nMean job times: freq {:.1f}s ({} jobs), single core force {:.1f}s ({} jobs)",
+                             mTimings->mean(HESS_METHOD, mNProc).value_or(0.), mTimings->count(HESS_METHOD, mNProc),
+                             mTimings->mean(FORCE_METHOD, 1).value_or(0.), mTimings->count(FORCE_METHOD, 1));
+
+    return statistics;
 }
 
-GaussianProducer& GaussianProducer::getFullInnerFunction()
+EvaluationCache const& GaussianProducer::getCache() const
 {
-    return *this;
+    return *mCache;
 }
 
-string GaussianProducer::createInputFile(vect const& x, string const& method) const
+void GaussianProducer::setResultStore(shared_ptr<ResultStore> store)
 {
-    string fileMask = format("./tmp/{}/", std::hash<std::thread::id>()(this_thread::get_id()));
+    mStore = move(store);
+}
 
-    system(("mkdir -p " + fileMask).c_str());
+void GaussianProducer::setJobPool(shared_ptr<JobPool> pool)
+{
+    mPool = move(pool);
+}
 
-    ofstream f(fileMask + "input");
-    f.precision(30);
-    f << format(GAUSSIAN_HEADER, fileMask, method, mNProc, mMem) << endl;
+ScratchManager& GaussianProducer::getScratchManager() const
+{
+    return *mScratch;
+}
 
-    for (size_t i = 0; i < mCharges.size(); i++) {
-        f << mCharges[i];
-        for (size_t j = 0; j < 3; j++)
-            f << "\t" << fixed << x(i * 3 + j);
-        f << endl;
-    }
-    f << endl;
+void GaussianProducer::setScratchManager(shared_ptr<ScratchManager> scratch)
+{
+    mScratch = move(scratch);
+    mCheckpoints = make_shared<CheckpointHistory>(mScratch->acquire());
+}
 
-    return fileMask;
+CheckpointHistory const& GaussianProducer::getCheckpointHistory() const
+{
+    return *mCheckpoints;
 }
 
-double GaussianProducer::parseValue(ifstream& input) const
+shared_ptr<HessianHistory> const& GaussianProducer::getHessianHistory() const
 {
-    string s;
-    while (!boost::starts_with(s, "Total Energy"))
-        getline(input, s);
-    stringstream ss(s);
-    ss >> s >> s >> s;
+    return mHessians;
+}
 
-    double value;
-    ss >> value;
+void GaussianProducer::setHessianReuse(shared_ptr<HessianHistory> hessians)
+{
+    mHessians = move(hessians);
+    renewNodeId();
+}
 
-    return value;
+ProcessLauncher& GaussianProducer::getProcessLauncher() const
+{
+    return *mLauncher;
 }
 
-vect GaussianProducer::parseGrad(ifstream& input) const
+void GaussianProducer::setProcessLauncher(shared_ptr<ProcessLauncher> launcher)
 {
-    string s;
-    while (!boost::starts_with(s, "Cartesian Gradient"))
-        getline(input, s);
+    mLauncher = move(launcher);
+}
 
-    vect grad(nDims);
-    for (size_t i = 0; i < nDims; i++) {
-        input >> grad(i);
-        grad(i) *= MAGIC_CONSTANT;
-    }
+GaussianProducer::HessianMode GaussianProducer::getHessianMode() const
+{
+    return mHessianMode;
+}
 
-    return grad;
+void GaussianProducer::setHessianMode(HessianMode mode, double step)
+{
+    mHessianMode = mode;
+    mStep = step;
+    renewNodeId();
 }
 
-matrix GaussianProducer::parseHess(ifstream& input) const
+JobTimings const& GaussianProducer::getJobTimings() const
 {
-    string s;
-    while (!boost::starts_with(s, "Cartesian Force Constants"))
-        getline(input, s);
+    return *mTimings;
+}
 
-    matrix hess(nDims, nDims);
-    for (size_t i = 0; i < nDims; i++)
-        for (size_t j = 0; j <= i; j++) {
-            input >> hess(i, j);
-            hess(i, j) *= MAGIC_CONSTANT * MAGIC_CONSTANT;
-            hess(j, i) = hess(i, j);
-        }
+BackendUsage& GaussianProducer::getUsage() const
+{
+    return *mUsage;
+}
 
-    return hess;
+void GaussianProducer::setUsage(shared_ptr<BackendUsage> usage)
+{
+    mUsage = move(usage);
+    renewNodeId();
 }
 
-vect GaussianProducer::parseStructure(ifstream& input) const
+GaussianProducer const& GaussianProducer::getFullInnerFunction() const
 {
-    string s;
-    while (!boost::starts_with(s, "Current cartesian coordinates"))
-        getline(input, s);
+    return *this;
+}
 
+GaussianProducer& GaussianProducer::getFullInnerFunction()
+{
+    return *this;
+}
 
-    vect structure(nDims);
-    for (size_t i = 0; i < nDims; i++) {
-        input >> structure(i);
-        structure(i) /= MAGIC_CONSTANT;
-    }
+void GaussianProducer::createInputFile(string const& directory, vect const& x, string const& method,
+                                       string const& keywords) const
+{
+    ofstream f(directory + "input");
+    f.precision(30);
+    f << format(GAUSSIAN_HEADER, directory, method, mNProc, mMem, LEVEL_OF_THEORY, keywords) << endl;
 
-    return structure;
-}
\ No newline at end of file
+    for (size_t i = 0; i < mCharges.size(); i++) {
+        f << mCharges[i];
+        for (size_t j = 0; j < 3; j++)
+            f << "\t" << fixed << x(i * 3 + j);
+        f << endl;
+    }
+    f << endl;
+}
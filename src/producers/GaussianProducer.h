@@ -1,31 +1,57 @@
 #pragma once
 
-#include <boost/algorithm/string/predicate.hpp>
-
-#include "FunctionProducer.h"
+#include "MoleculeProducer.h"
 #include "inputOutputUtils.h"
+#include "gaussian/GaussianResult.h"
+#include "gaussian/EvaluationCache.h"
+#include "gaussian/ResultStore.h"
+#include "gaussian/JobPool.h"
+#include "gaussian/ScratchManager.h"
+#include "gaussian/ProcessLauncher.h"
+#include "gaussian/CheckpointHistory.h"
+#include "gaussian/HessianHistory.h"
+#include "gaussian/JobTimings.h"
+#include "gaussian/BackendUsage.h"
+#include "gaussian/FchkParser.h"
 
 extern string const GAUSSIAN_HEADER;
+extern string const LEVEL_OF_THEORY;
 extern string const SCF_METHOD;
 extern string const FORCE_METHOD;
 extern string const HESS_METHOD;
 extern string const OPT_METHOD;
 
+size_t methodOrder(string const& method);
+
 class GaussianException : public exception
 {
 public:
-    explicit GaussianException(std::thread::id threadId)
-            : mThreadId(threadId), mThreadHash(std::hash<thread::id>()(mThreadId))
-    { }
+    enum class Reason
+    {
+        LaunchFailure, Timeout, Cancelled, Signaled, NonzeroExit, ParseFailure
+    };
+
+    GaussianException(Reason reason, string const& details);
+
+    char const* what() const noexcept override;
+    Reason getReason() const;
 
 private:
-    std::thread::id const mThreadId;
-    size_t const mThreadHash;
+    Reason const mReason;
+    string const mMessage;
 };
 
-class GaussianProducer : public FunctionProducer {
+class GaussianProducer final : public MoleculeProducer {
 public:
     static constexpr double MAGIC_CONSTANT = 1.88972585931612435672;
+    static constexpr double FINITE_DIFFERENCE_STEP = 5e-3;
+
+    //how exact Hessians are obtained: one analytic freq job, central differences of gradients from force jobs run
+    //side by side on one core each, or whichever of the two the measured job timings predict to be faster
+    enum class HessianMode
+    {
+        Analytic, FiniteDifference, Auto
+    };
 
     explicit GaussianProducer(vector<size_t> charges, size_t nProc = 1, size_t mem = 1000);
 
@@ -34,29 +60,66 @@ public:
     matrix hess(vect const &x) override;
     tuple<double, vect> valueGrad(vect const& x) override;
     tuple<double, vect, matrix> valueGradHess(vect const& x) override;
+    vect hessVec(vect const& x, vect const& v) override;
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override;
+
+    //Hessian from gradients displaced along the orthonormal columns of basis; outside of their span it is zero
+    tuple<double, vect, matrix> finiteDifferenceValueGradHess(vect const& x, matrix const& basis);
+    tuple<double, vect, matrix> finiteDifferenceValueGradHess(vect const& x);
 
-    vect optimize(vect const&) const;
+    future<GaussianResult> submit(vect const& x, string const& method);
+    future<tuple<double, vect>> asyncValueGrad(vect const& x);
+    future<tuple<double, vect, matrix>> asyncValueGradHess(vect const& x);
+
+    vect optimize(vect const&) const override;
 
-    vector<size_t> const& getCharges() const;
-    vect transform(vect from) const;
-    vect fullTransform(vect from) const;
     GaussianProducer const& getFullInnerFunction() const;
     GaussianProducer& getFullInnerFunction();
 
-    void setGaussianNProc(size_t nProc);
-    void setGaussianMem(size_t mem);
+    void setNProc(size_t nProc) override;
+    void setMem(size_t mem) override;
+    string getStatistics() const override;
+
+    EvaluationCache const& getCache() const;
+    void setResultStore(shared_ptr<ResultStore> store);
+    void setJobPool(shared_ptr<JobPool> pool);
+    ScratchManager& getScratchManager() const;
+    void setScratchManager(shared_ptr<ScratchManager> scratch);
+    CheckpointHistory const& getCheckpointHistory() const;
+    shared_ptr<HessianHistory> const& getHessianHistory() const;
+    //exact Hessians are added to hessians, and those asked for inside a HessianReuseScope may be updated from them
+    void setHessianReuse(shared_ptr<HessianHistory> hessians);
+    ProcessLauncher& getProcessLauncher() const;
+    void setProcessLauncher(shared_ptr<ProcessLauncher> launcher);
+    HessianMode getHessianMode() const;
+    void setHessianMode(HessianMode mode, double step = FINITE_DIFFERENCE_STEP);
+    JobTimings const& getJobTimings() const;
+    BackendUsage& getUsage() const override;
+    void setUsage(shared_ptr<BackendUsage> usage);
 
 private:
     size_t mNProc;
     size_t mMem;
+    HessianMode mHessianMode;
+    double mStep;
 
-    vector<size_t> mCharges;
+    shared_ptr<EvaluationCache> mCache;
+    shared_ptr<ResultStore> mStore;
+    shared_ptr<JobPool> mPool;
+    shared_ptr<ScratchManager> mScratch;
+    shared_ptr<CheckpointHistory> mCheckpoints;
+    shared_ptr<HessianHistory> mHessians;
+    shared_ptr<ProcessLauncher> mLauncher;
+    shared_ptr<JobTimings> mTimings;
+    shared_ptr<BackendUsage> mUsage;
 
-    ifstream runGaussian(vect const& x, string const& method) const;
-    string createInputFile(vect const &x, string const& method) const;
-    double parseValue(ifstream& input) const;
-    vect parseGrad(ifstream& input) const;
-    matrix parseHess(ifstream& input) const;
-    vect parseStructure(ifstream& input) const;
+    GaussianResult calculate(vect const& x, string const& method);
+    GaussianResult calculateHessian(vect const& x);
+    GaussianResult finiteDifferenceHessian(vect const& x, GaussianResult const& center, matrix const& basis);
+    bool prefersFiniteDifferences() const;
+    GaussianResult parseResult(string const& fchkPath, string const& method) const;
+    void runGaussian(string const& directory, vect const& x, string const& method, bool guessRead) const;
+    void createInputFile(string const& directory, vect const &x, string const& method,
+                         string const& keywords) const;
 };
 
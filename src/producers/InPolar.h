@@ -3,11 +3,12 @@
 #include "helper.h"
 
 #include "FunctionProducer.h"
+#include "Workspace.h"
 #include "linearAlgebraUtils.h"
 #include "AffineTransformation.h"
 
 template<typename FuncT>
-class InPolar : public FunctionProducer
+class InPolar final : public FunctionProducer
 {
 public:
     InPolar(FuncT func, double r)
@@ -18,21 +19,21 @@ public:
     {
         assert((size_t) phi.rows() == nDims);
 
-        return mFunc(transform(phi));
+        return statically(mFunc)(transform(phi));
     }
 
     vect grad(vect const& phi) override
     {
         assert((size_t) phi.rows() == nDims);
 
-        return obtainGrad(phi, mFunc.grad(transform(phi)));
+        return obtainGrad(phi, statically(mFunc).grad(transform(phi)));
     }
 
     matrix hess(vect const& phi) override
     {
         assert((size_t) phi.rows() == nDims);
 
-        auto valueGradHess = mFunc.valueGradHess(transform(phi));
+        auto valueGradHess = statically(mFunc).valueGradHess(transform(phi));
         return obtainHess(phi, get<1>(valueGradHess), get<2>(valueGradHess));
     }
 
@@ -40,7 +41,7 @@ public:
     {
         assert((size_t) phi.rows() == nDims);
 
-        auto valueGrad = mFunc.valueGrad(transform(phi));
+        auto valueGrad = statically(mFunc).valueGrad(transform(phi));
         return make_tuple(get<0>(valueGrad), obtainGrad(phi, get<1>(valueGrad)));
     };
 
@@ -48,28 +49,82 @@ public:
     {
         assert((size_t) phi.rows() == nDims);
 
-        auto valueGradHess = mFunc.valueGradHess(transform(phi));
+        auto valueGradHess = statically(mFunc).valueGradHess(transform(phi));
         auto const& grad = get<1>(valueGradHess);
         auto const& hess = get<2>(valueGradHess);
 
         return make_tuple(get<0>(valueGradHess), obtainGrad(phi, grad), obtainHess(phi, grad, hess));
     };
 
-    vect transform(vect const &phi) const
+    void evaluateInto(vect const& phi, size_t order, Evaluation& result) override
     {
         assert((size_t) phi.rows() == nDims);
 
-        vect x(nDims + 1);
-        double sinProduct = 1;
-        for (size_t i = 0; i < nDims; i++) {
-            x(i) = mR * sinProduct * cos(phi[i]);
-            sinProduct *= sin(phi[i]);
+        Workspace::Frame frame;
+        auto& x = frame.getVect(0, nDims + 1);
+        transformInto(phi, x);
+
+        auto& inner = frame.getEvaluation(0, mFunc.nDims);
+        statically(mFunc).evaluateInto(x, order, inner);
+
+        result.value = inner.value;
+        if (order >= 1)
+            obtainGradInto(phi, inner.grad, result.grad);
+        if (order >= 2)
+            obtainHessInto(phi, inner.grad, inner.hess, result.hess);
+    }
+
+    vect hessVec(vect const& phi, vect const& v) override
+    {
+        assert((size_t) phi.rows() == nDims);
+        assert((size_t) v.rows() == nDims);
+
+        auto x = transform(phi);
+        auto curvature = get<1>(pullBack(phi, statically(mFunc).grad(x), v));
+        auto innerHessVec = statically(mFunc).hessVec(x, pushForward(phi, v));
+        return get<0>(pullBack(phi, innerHessVec, makeConstantVect(nDims))) + curvature;
+    }
+
+    BatchResult evaluateBatch(matrix const& phis, size_t order) override
+    {
+        assert((size_t) phis.rows() == nDims);
+
+        matrix xs(nDims + 1, phis.cols());
+        for (long i = 0; i < phis.cols(); i++)
+            xs.col(i) = transform(phis.col(i));
+
+        auto result = statically(mFunc).evaluateBatch(xs, order);
+        for (size_t i = 0; i < result.hesses.size(); i++)
+            result.hesses[i] = obtainHess(phis.col(i), result.grads.col(i), result.hesses[i]);
+        if (order >= 1) {
+            matrix grads(nDims, phis.cols());
+            for (long i = 0; i < phis.cols(); i++)
+                grads.col(i) = obtainGrad(phis.col(i), result.grads.col(i));
+            result.grads = move(grads);
         }
-        x(nDims) = mR * sinProduct;
+        return result;
+    }
 
+    vect transform(vect const &phi) const
+    {
+        vect x;
+        transformInto(phi, x);
         return x;
     }
 
+    void transformInto(vect const& phi, vect& x) const
+    {
+        assert((size_t) phi.rows() == nDims);
+
+        x.resize(nDims + 1);
+        double sinProduct = mR;
+        for (size_t i = 0; i < nDims; i++) {
+            x(i) = sinProduct * cos(phi(i));
+            sinProduct *= sin(phi(i));
+        }
+        x(nDims) = sinProduct;
+    }
+
     vect fullTransform(vect const& phi) const
     {
         return mFunc.fullTransform(transform(phi));
@@ -81,90 +136,167 @@ public:
     }
 
 public:
-    matrix calculateDerivatives(vect const& phi)
-    {
-        matrix m(nDims + 1, nDims);
-        for (size_t i = 0; i < nDims + 1; i++)
-            for (size_t j = 0; j < nDims; j++)  {
-                if (i < j) {
-                    m(i, j) = 0;
-                    continue;
-                }
-
-                double product = 1.;
-
-                for (size_t k = 0; k < min(i + 1, nDims); k++)
-                    if (k == j && k == i)
-                        product *= -sin(phi(k));
-                    else if (k == j || k == i)
-                        product *= cos(phi(k));
-                    else if (k <= i)
-                        product *= sin(phi(k));
-
-                m(i, j) = mR * product;
-            }
+    //Jacobian of transform, column j from the prefix product of sines up to j and a running product after it, in O(n^2)
+    matrix calculateDerivatives(vect const& phi) const
+    {
+        matrix m;
+        calculateDerivativesInto(phi, m);
         return m;
     }
 
-    matrix calculateSecondDerivatives(vect const& phi, size_t j)
-    {
-        matrix m(nDims + 1, nDims);
-        for (size_t i = 0; i < nDims + 1; i++)
-            for (size_t k = 0; k < nDims; k++)  {
-                if (i < j || i < k) {
-                    m(i, k) = 0;
-                    continue;
-                }
-
-                double product = 1.;
-
-                for (size_t l = 0; l < min(i + 1, nDims); l++)
-                    if (l == i) {
-                        if (l == j && l == k)
-                            product *= -cos(phi(l));
-                        else if (l == j || l == k)
-                            product *= -sin(phi(l));
-                        else
-                            product *= cos(phi(l));
-                    }
-                    else {
-                        if (l == j && l == k)
-                            product *= -sin(phi(l));
-                        else if (l == j || l == k)
-                            product *= cos(phi(l));
-                        else
-                            product *= sin(phi(l));
-                    }
-
-                m(i, k) = mR * product;
+    void calculateDerivativesInto(vect const& phi, matrix& m) const
+    {
+        Workspace::Frame frame;
+        auto s = frame.getVect(0, nDims).array();
+        auto c = frame.getVect(1, nDims).array();
+        s = phi.array().sin();
+        c = phi.array().cos();
+
+        m.setZero(nDims + 1, nDims);
+        double sinProduct = mR;
+        for (size_t j = 0; j < nDims; j++) {
+            m(j, j) = -sinProduct * s(j);
+
+            double product = sinProduct * c(j);
+            for (size_t i = j + 1; i < nDims; i++) {
+                m(i, j) = product * c(i);
+                product *= s(i);
             }
+            m(nDims, j) = product;
 
-        return m;
-    };
+            sinProduct *= s(j);
+        }
+    }
 
-    vect obtainGrad(vect const& phi, vect const& grad)
+    //sum_k grad_k hess(transform_k), in O(n^2). With the tails T_j = grad_j cos(phi_j) + sin(phi_j) T_{j + 1} and
+    //U_j = dT_j / dphi_j the diagonal is -R P_j T_j and above it (i, j) is R P_i cos(phi_i) U_j times the sines
+    //strictly between i and j, where P_j is the product of the sines before j
+    matrix calculateCurvature(vect const& phi, vect const& grad) const
     {
-        return grad.transpose() * calculateDerivatives(phi);
+        matrix curvature;
+        calculateCurvatureInto(phi, grad, curvature);
+        return curvature;
     }
 
-    //todo: pull calculateSecondDerivatives higher?
-    matrix obtainHess(vect const& phi, vect const& grad, matrix const& hess)
+    void calculateCurvatureInto(vect const& phi, vect const& grad, matrix& curvature) const
     {
-        auto m = calculateDerivatives(phi);
-        auto result = makeConstantMatrix(nDims, nDims);
+        Workspace::Frame frame;
+        auto s = frame.getVect(0, nDims).array();
+        auto c = frame.getVect(1, nDims).array();
+        s = phi.array().sin();
+        c = phi.array().cos();
+
+        auto& tails = frame.getVect(2, nDims + 1);
+        auto& tailDerivatives = frame.getVect(3, nDims);
+        tails(nDims) = grad(nDims);
+        for (size_t j = nDims; j-- > 0;) {
+            tailDerivatives(j) = -grad(j) * s(j) + c(j) * tails(j + 1);
+            tails(j) = grad(j) * c(j) + s(j) * tails(j + 1);
+        }
 
+        curvature.resize(nDims, nDims);
+        double sinProduct = mR;
         for (size_t i = 0; i < nDims; i++) {
-            for (size_t j = 0; j < nDims; j++) {
-                for (size_t k = 0; k < nDims + 1; k++) {
-                    result(i, j) += (hess.row(k) * m.col(j) * m(k, i))(0, 0);
-                    result(i, j) += grad(k) * calculateSecondDerivatives(phi, i)(k, j);
-                }
+            curvature(i, i) = -sinProduct * tails(i);
+
+            double product = sinProduct * c(i);
+            for (size_t j = i + 1; j < nDims; j++) {
+                curvature(i, j) = curvature(j, i) = product * tailDerivatives(j);
+                product *= s(j);
             }
+
+            sinProduct *= s(i);
+        }
+    }
+
+    //J v for the Jacobian J of transform, in O(n)
+    vect pushForward(vect const& phi, vect const& v) const
+    {
+        vect dx(nDims + 1);
+        double sinProduct = 1, dSinProduct = 0;
+        for (size_t i = 0; i < nDims; i++) {
+            double s = sin(phi(i)), c = cos(phi(i));
+            dx(i) = mR * (c * dSinProduct - s * v(i) * sinProduct);
+            dSinProduct = dSinProduct * s + sinProduct * c * v(i);
+            sinProduct *= s;
+        }
+        dx(nDims) = mR * dSinProduct;
+
+        return dx;
+    }
+
+    //J^T g and its derivative along v with g held fixed, i.e. sum_k g_k hess(transform_k) v, both in O(n)
+    tuple<vect, vect> pullBack(vect const& phi, vect const& g, vect const& v) const
+    {
+        Eigen::ArrayXd s = phi.array().sin(), c = phi.array().cos();
+
+        vect sinProducts(nDims + 1), dSinProducts(nDims + 1);
+        sinProducts(0) = 1, dSinProducts(0) = 0;
+        for (size_t j = 0; j < nDims; j++) {
+            sinProducts(j + 1) = sinProducts(j) * s(j);
+            dSinProducts(j + 1) = dSinProducts(j) * s(j) + sinProducts(j) * c(j) * v(j);
+        }
+
+        vect grad(nDims), dGrad(nDims);
+        double tail = g(nDims), dTail = 0;
+        for (size_t j = nDims; j-- > 0;) {
+            double w = -g(j) * s(j) + c(j) * tail;
+            double dw = -v(j) * (g(j) * c(j) + s(j) * tail) + c(j) * dTail;
+
+            grad(j) = mR * sinProducts(j) * w;
+            dGrad(j) = mR * (dSinProducts(j) * w + sinProducts(j) * dw);
+
+            dTail = v(j) * (c(j) * tail - g(j) * s(j)) + s(j) * dTail;
+            tail = g(j) * c(j) + s(j) * tail;
         }
 
+        return make_tuple(grad, dGrad);
+    }
+
+    vect obtainGrad(vect const& phi, vect const& grad) const
+    {
+        vect result;
+        obtainGradInto(phi, grad, result);
+        return result;
+    }
+
+    //J^T g as in pullBack: the prefix products of sines go forward into result, the tails are multiplied in backwards
+    void obtainGradInto(vect const& phi, vect const& grad, vect& result) const
+    {
+        result.resize(nDims);
+        double sinProduct = mR;
+        for (size_t j = 0; j < nDims; j++) {
+            result(j) = sinProduct;
+            sinProduct *= sin(phi(j));
+        }
+
+        double tail = grad(nDims);
+        for (size_t j = nDims; j-- > 0;) {
+            double s = sin(phi(j)), c = cos(phi(j));
+            result(j) *= -grad(j) * s + c * tail;
+            tail = grad(j) * c + s * tail;
+        }
+    }
+
+    matrix obtainHess(vect const& phi, vect const& grad, matrix const& hess) const
+    {
+        matrix result;
+        obtainHessInto(phi, grad, hess, result);
         return result;
     }
 
+    void obtainHessInto(vect const& phi, vect const& grad, matrix const& hess, matrix& result) const
+    {
+        Workspace::Frame frame;
+        auto& m = frame.getMatrix(0, nDims + 1, nDims);
+        auto& hessM = frame.getMatrix(1, nDims + 1, nDims);
+        calculateDerivativesInto(phi, m);
+        hessM.noalias() = hess * m;
+
+        calculateCurvatureInto(phi, grad, result);
+        result.noalias() += m.transpose() * hessM;
+    }
+
     FuncT mFunc;
     double mR;
 };
@@ -179,7 +311,7 @@ auto makePolar(FuncT&& func, double r)
 template<typename FuncT>
 auto makePolarWithDirection(FuncT&& func, double r, vect const& dir)
 {
-    auto rotation = rotationMatrix(eye(func.nDims, func.nDims - 1), dir);
+    auto rotation = HouseholderRotation(eye(func.nDims, func.nDims - 1), dir);
     auto rotated = makeAffineTransfomation(func, rotation);
     return makePolar(move(rotated), r);
 }
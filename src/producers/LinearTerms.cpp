@@ -0,0 +1,137 @@
+#include "LinearTerms.h"
+
+#include "Workspace.h"
+
+vector<LinearTerm> linearTerms(FunctionProducer& func)
+{
+    vector<LinearTerm> terms;
+    linearTermsInto(func, terms);
+    return terms;
+}
+
+void linearTermsInto(FunctionProducer& func, vector<LinearTerm>& terms)
+{
+    terms.clear();
+    func.collectLinearTerms(1., terms);
+
+    size_t merged = 0;
+    for (size_t i = 0; i < terms.size(); i++) {
+        size_t j = 0;
+        while (j < merged && terms[j].func->getNodeId() != terms[i].func->getNodeId())
+            j++;
+
+        if (j == merged)
+            terms[merged++] = terms[i];
+        else
+            terms[j].factor += terms[i].factor;
+    }
+
+    terms.resize(merged);
+}
+
+double linearValue(vector<LinearTerm> const& terms, vect const& x)
+{
+    double value = 0;
+    for (auto const& term : terms)
+        value += term.factor * (*term.func)(x);
+    return value;
+}
+
+vect linearGrad(vector<LinearTerm> const& terms, vect const& x)
+{
+    vect grad = terms[0].factor * terms[0].func->grad(x);
+    for (size_t i = 1; i < terms.size(); i++)
+        grad += terms[i].factor * terms[i].func->grad(x);
+    return grad;
+}
+
+matrix linearHess(vector<LinearTerm> const& terms, vect const& x)
+{
+    matrix hess = terms[0].factor * terms[0].func->hess(x);
+    for (size_t i = 1; i < terms.size(); i++)
+        hess += terms[i].factor * terms[i].func->hess(x);
+    return hess;
+}
+
+tuple<double, vect> linearValueGrad(vector<LinearTerm> const& terms, vect const& x)
+{
+    auto result = terms[0].func->valueGrad(x);
+    get<0>(result) *= terms[0].factor;
+    get<1>(result) *= terms[0].factor;
+
+    for (size_t i = 1; i < terms.size(); i++) {
+        auto valueGrad = terms[i].func->valueGrad(x);
+        get<0>(result) += terms[i].factor * get<0>(valueGrad);
+        get<1>(result) += terms[i].factor * get<1>(valueGrad);
+    }
+
+    return result;
+}
+
+tuple<double, vect, matrix> linearValueGradHess(vector<LinearTerm> const& terms, vect const& x)
+{
+    auto result = terms[0].func->valueGradHess(x);
+    get<0>(result) *= terms[0].factor;
+    get<1>(result) *= terms[0].factor;
+    get<2>(result) *= terms[0].factor;
+
+    for (size_t i = 1; i < terms.size(); i++) {
+        auto valueGradHess = terms[i].func->valueGradHess(x);
+        get<0>(result) += terms[i].factor * get<0>(valueGradHess);
+        get<1>(result) += terms[i].factor * get<1>(valueGradHess);
+        get<2>(result) += terms[i].factor * get<2>(valueGradHess);
+    }
+
+    return result;
+}
+
+void linearEvaluateInto(FunctionProducer& func, vect const& x, size_t order, Evaluation& result)
+{
+    Workspace::Frame frame;
+    auto& terms = frame.getTerms();
+    linearTermsInto(func, terms);
+
+    terms[0].func->evaluateInto(x, order, result);
+    result.value *= terms[0].factor;
+    if (order >= 1)
+        result.grad *= terms[0].factor;
+    if (order >= 2)
+        result.hess *= terms[0].factor;
+
+    auto& evaluation = frame.getEvaluation(0, func.nDims);
+    for (size_t i = 1; i < terms.size(); i++) {
+        terms[i].func->evaluateInto(x, order, evaluation);
+        result.value += terms[i].factor * evaluation.value;
+        if (order >= 1)
+            result.grad += terms[i].factor * evaluation.grad;
+        if (order >= 2)
+            result.hess += terms[i].factor * evaluation.hess;
+    }
+}
+
+vect linearHessVec(vector<LinearTerm> const& terms, vect const& x, vect const& v)
+{
+    vect result = terms[0].factor * terms[0].func->hessVec(x, v);
+    for (size_t i = 1; i < terms.size(); i++)
+        result += terms[i].factor * terms[i].func->hessVec(x, v);
+    return result;
+}
+
+BatchResult linearEvaluateBatch(vector<LinearTerm> const& terms, matrix const& xs, size_t order)
+{
+    auto result = terms[0].func->evaluateBatch(xs, order);
+    result.values *= terms[0].factor;
+    result.grads *= terms[0].factor;
+    for (auto& hess : result.hesses)
+        hess *= terms[0].factor;
+
+    for (size_t i = 1; i < terms.size(); i++) {
+        auto batch = terms[i].func->evaluateBatch(xs, order);
+        result.values += terms[i].factor * batch.values;
+        result.grads += terms[i].factor * batch.grads;
+        for (size_t j = 0; j < result.hesses.size(); j++)
+            result.hesses[j] += terms[i].factor * batch.hesses[j];
+    }
+
+    return result;
+}
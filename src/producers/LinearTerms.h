@@ -0,0 +1,20 @@
+#pragma once
+
+#include "helper.h"
+
+#include "FunctionProducer.h"
+
+//the leaves of func with the copies of one producer merged, so that a producer reused across an expression such as
+//alpha * f + (1 - alpha) * (f + g) is evaluated once per point and the combination is formed afterwards
+vector<LinearTerm> linearTerms(FunctionProducer& func);
+void linearTermsInto(FunctionProducer& func, vector<LinearTerm>& terms);
+
+double linearValue(vector<LinearTerm> const& terms, vect const& x);
+vect linearGrad(vector<LinearTerm> const& terms, vect const& x);
+matrix linearHess(vector<LinearTerm> const& terms, vect const& x);
+tuple<double, vect> linearValueGrad(vector<LinearTerm> const& terms, vect const& x);
+tuple<double, vect, matrix> linearValueGradHess(vector<LinearTerm> const& terms, vect const& x);
+//evaluates the merged leaves of func into result, with the terms and the leaf results kept in the thread's workspace
+void linearEvaluateInto(FunctionProducer& func, vect const& x, size_t order, Evaluation& result);
+vect linearHessVec(vector<LinearTerm> const& terms, vect const& x, vect const& v);
+BatchResult linearEvaluateBatch(vector<LinearTerm> const& terms, matrix const& xs, size_t order);
@@ -0,0 +1,74 @@
+#include "MoleculeProducer.h"
+
+#include <Eigen/Eigenvalues>
+
+#include "linearAlgebraUtils.h"
+
+MoleculeProducer::MoleculeProducer(vector<size_t> charges) : FunctionProducer(charges.size() * 3),
+                                                             mCharges(move(charges))
+{ }
+
+void MoleculeProducer::setNProc(size_t)
+{ }
+
+void MoleculeProducer::setMem(size_t)
+{ }
+
+string MoleculeProducer::getStatistics() const
+{
+    return "";
+}
+
+BackendUsage& MoleculeProducer::getUsage() const
+{
+    return *BackendUsage::global();
+}
+
+vector<size_t> const& MoleculeProducer::getCharges() const
+{
+    return mCharges;
+}
+
+vect MoleculeProducer::transform(vect from) const
+{
+    return from;
+}
+
+vect MoleculeProducer::fullTransform(vect from) const
+{
+    return from;
+}
+
+vect newtonMinimize(FunctionProducer& func, vect x, double gradNorm, double maxStep, size_t iterLimit)
+{
+    for (size_t iter = 0; iter < iterLimit; iter++) {
+        auto valueGradHess = func.valueGradHess(x);
+        auto const& grad = get<1>(valueGradHess);
+        if (grad.norm() < gradNorm)
+            break;
+
+        Eigen::SelfAdjointEigenSolver<matrix> solver(get<2>(valueGradHess));
+        vect projected = solver.eigenvectors().transpose() * grad;
+        for (size_t i = 0; i < func.nDims; i++) {
+            double value = abs(solver.eigenvalues()(i));
+            projected(i) = value > 1e-8 ? projected(i) / value : 0.;
+        }
+
+        vect delta = -solver.eigenvectors() * projected;
+        if (delta.norm() > maxStep)
+            delta *= maxStep / delta.norm();
+        x += delta;
+    }
+
+    return x;
+}
+
+matrix translationFreeBasis(size_t nAtoms)
+{
+    matrix translations = makeConstantMatrix(nAtoms * 3, 3);
+    for (size_t i = 0; i < nAtoms; i++)
+        translations.block<3, 3>(i * 3, 0) = Eigen::Matrix3d::Identity();
+
+    matrix q = translations.householderQr().householderQ();
+    return q.rightCols(nAtoms * 3 - 3);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "helper.h"
+
+#include "FunctionProducer.h"
+#include "gaussian/BackendUsage.h"
+
+//potential energy surface of a molecule in cartesian coordinates (angstroms) provided by some electronic structure
+//backend: an external QM program or an in-process analytic potential
+class MoleculeProducer : public FunctionProducer
+{
+public:
+    explicit MoleculeProducer(vector<size_t> charges);
+
+    virtual vect optimize(vect const& structure) const = 0;
+
+    virtual void setNProc(size_t nProc);
+    virtual void setMem(size_t mem);
+    virtual string getStatistics() const;
+    //where the backend records its jobs; analytic backends run none, so theirs is the global one and stays empty
+    virtual BackendUsage& getUsage() const;
+
+    vector<size_t> const& getCharges() const;
+    vect transform(vect from) const;
+    vect fullTransform(vect from) const;
+
+protected:
+    vector<size_t> mCharges;
+};
+
+//damped Newton descent on |hess| with a step length cap; used by analytic backends to relax structures
+vect newtonMinimize(FunctionProducer& func, vect x, double gradNorm = 1e-9, double maxStep = .1,
+                    size_t iterLimit = 1000);
+
+//orthonormal basis of the 3 nAtoms - 3 dimensional complement of rigid translations
+matrix translationFreeBasis(size_t nAtoms);
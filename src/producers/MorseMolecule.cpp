@@ -0,0 +1,112 @@
+#include "MorseMolecule.h"
+
+namespace
+{
+    double const COVALENT_RADII[] = {
+       .31, .28,                                    //H, He
+       1.28, .96, .84, .76, .71, .66, .57, .58,     //Li - Ne
+       1.66, 1.41, 1.21, 1.11, 1.07, 1.05, 1.02, 1.06, //Na - Ar
+    };
+}
+
+double covalentRadius(size_t charge)
+{
+    if (charge >= 1 && charge <= sizeof(COVALENT_RADII) / sizeof(COVALENT_RADII[0]))
+        return COVALENT_RADII[charge - 1];
+    return 1.5;
+}
+
+MorseMolecule::MorseMolecule(vector<size_t> charges, double depth, double width) : MoleculeProducer(move(charges)),
+                                                                                     mDepth(depth), mWidth(width)
+{
+    size_t n = mCharges.size();
+    mEquilibriumDistances.resize(n, n);
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < n; j++)
+            mEquilibriumDistances(i, j) = covalentRadius(mCharges[i]) + covalentRadius(mCharges[j]);
+}
+
+double MorseMolecule::operator()(vect const& x)
+{
+    assert((size_t) x.rows() == nDims);
+
+    return get<0>(calculate(x, 0));
+}
+
+vect MorseMolecule::grad(vect const& x)
+{
+    return get<1>(valueGrad(x));
+}
+
+matrix MorseMolecule::hess(vect const& x)
+{
+    return get<2>(valueGradHess(x));
+}
+
+tuple<double, vect> MorseMolecule::valueGrad(vect const& x)
+{
+    assert((size_t) x.rows() == nDims);
+
+    auto result = calculate(x, 1);
+    return make_tuple(get<0>(result), get<1>(result));
+}
+
+tuple<double, vect, matrix> MorseMolecule::valueGradHess(vect const& x)
+{
+    assert((size_t) x.rows() == nDims);
+
+    return calculate(x, 2);
+}
+
+vect MorseMolecule::optimize(vect const& structure) const
+{
+    auto molecule = *this;
+    return newtonMinimize(molecule, structure);
+}
+
+MorseMolecule const& MorseMolecule::getFullInnerFunction() const
+{
+    return *this;
+}
+
+MorseMolecule& MorseMolecule::getFullInnerFunction()
+{
+    return *this;
+}
+
+tuple<double, vect, matrix> MorseMolecule::calculate(vect const& x, size_t order) const
+{
+    size_t n = mCharges.size();
+
+    double value = 0;
+    vect grad = makeConstantVect(order >= 1 ? nDims : 0, 0.);
+    matrix hess = makeConstantMatrix(order >= 2 ? nDims : 0, order >= 2 ? nDims : 0, 0.);
+
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = i + 1; j < n; j++) {
+            Eigen::Vector3d d = x.segment<3>(i * 3) - x.segment<3>(j * 3);
+            double r = d.norm();
+            double e = exp(-mWidth * (r - mEquilibriumDistances(i, j)));
+
+            value += mDepth * ((1 - e) * (1 - e) - 1);
+            if (order < 1)
+                continue;
+
+            double first = 2 * mDepth * mWidth * e * (1 - e);
+            Eigen::Vector3d u = d / r;
+            grad.segment<3>(i * 3) += first * u;
+            grad.segment<3>(j * 3) -= first * u;
+            if (order < 2)
+                continue;
+
+            double second = 2 * mDepth * mWidth * mWidth * e * (2 * e - 1);
+            Eigen::Matrix3d uu = u * u.transpose();
+            Eigen::Matrix3d block = second * uu + first / r * (Eigen::Matrix3d::Identity() - uu);
+            hess.block<3, 3>(i * 3, i * 3) += block;
+            hess.block<3, 3>(j * 3, j * 3) += block;
+            hess.block<3, 3>(i * 3, j * 3) -= block;
+            hess.block<3, 3>(j * 3, i * 3) -= block;
+        }
+
+    return make_tuple(value, grad, hess);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "helper.h"
+
+#include "MoleculeProducer.h"
+#include "linearAlgebraUtils.h"
+
+//in-process analytic backend: sum of Morse pair potentials with equilibrium distances from covalent radii.
+//Energies are in hartrees, coordinates in angstroms, dissociated atoms have zero energy.
+class MorseMolecule final : public MoleculeProducer
+{
+public:
+    static constexpr double DEFAULT_DEPTH = .15;
+    static constexpr double DEFAULT_WIDTH = 1.8;
+
+    explicit MorseMolecule(vector<size_t> charges, double depth = DEFAULT_DEPTH, double width = DEFAULT_WIDTH);
+
+    double operator()(vect const& x) override;
+    vect grad(vect const& x) override;
+    matrix hess(vect const& x) override;
+    tuple<double, vect> valueGrad(vect const& x) override;
+    tuple<double, vect, matrix> valueGradHess(vect const& x) override;
+
+    vect optimize(vect const& structure) const override;
+
+    MorseMolecule const& getFullInnerFunction() const;
+    MorseMolecule& getFullInnerFunction();
+
+private:
+    double mDepth;
+    double mWidth;
+    matrix mEquilibriumDistances;
+
+    tuple<double, vect, matrix> calculate(vect const& x, size_t order) const;
+};
+
+double covalentRadius(size_t charge);
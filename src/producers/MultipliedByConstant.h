@@ -3,9 +3,10 @@
 #include "helper.h"
 
 #include "FunctionProducer.h"
+#include "LinearTerms.h"
 
 template<typename FuncT>
-class MultipliedByConstant : public FunctionProducer
+class MultipliedByConstant final : public FunctionProducer
 {
 public:
     MultipliedByConstant(FuncT func, double factor) : FunctionProducer(func.nDims), mFunc(func), mFactor(factor)
@@ -13,31 +14,49 @@ public:
 
     double operator()(vect const& x) override
     {
-        return mFactor * mFunc(x);
+        return linearValue(linearTerms(*this), x);
     }
 
     vect grad(vect const& x) override
     {
-        return mFactor * mFunc.grad(x);
+        return linearGrad(linearTerms(*this), x);
     }
 
     matrix hess(vect const& x) override
     {
-        return mFactor * mFunc.hess(x);
+        return linearHess(linearTerms(*this), x);
     };
 
     tuple<double, vect> valueGrad(vect const& x) override
     {
-        auto valueGrad = mFunc.valueGrad(x);
-        return make_tuple(mFactor * get<0>(valueGrad), mFactor * get<1>(valueGrad));
+        return linearValueGrad(linearTerms(*this), x);
     };
 
     tuple<double, vect, matrix> valueGradHess(vect const& x) override
     {
-        auto valueGradHess = mFunc.valueGradHess(x);
-        return make_tuple(mFactor * get<0>(valueGradHess), mFactor * get<1>(valueGradHess), mFactor * get<2>(valueGradHess));
+        return linearValueGradHess(linearTerms(*this), x);
     };
 
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        linearEvaluateInto(*this, x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        return linearHessVec(linearTerms(*this), x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        return linearEvaluateBatch(linearTerms(*this), xs, order);
+    }
+
+    void collectLinearTerms(double factor, vector<LinearTerm>& terms) override
+    {
+        statically(mFunc).collectLinearTerms(factor * mFactor, terms);
+    }
+
 private:
     FuncT mFunc;
     double mFactor;
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "helper.h"
+
+#include "FunctionProducer.h"
+#include "Workspace.h"
+#include "linearAlgebraUtils.h"
+
+//func restricted to the sphere of radius r, in coordinates of the tangent space at the point of the sphere along
+//direction: y goes to r (u + Q y) / |u + Q y| for the unit vector u along direction and an orthonormal basis Q of
+//its complement, taken from a Householder reflection of the last axis onto u. This is the projection retraction, not
+//the exponential map: y reaches the point at angle atan(|y|) from u rather than |y|, so only the open hemisphere
+//around u is covered and a step y moves along the sphere by r atan(|y|), e.g. 7% less than r |y| for |y| = .5.
+//At y = 0 the two maps agree to second order: the gradient r Q^T g and the Hessian r^2 Q^T H Q - r (g . u) I are
+//those of makePolarWithDirection around theta = pi / 2, so Newton steps taken from y = 0, as the sphere optimizers do,
+//keep their quadratic convergence. Stop strategies get the ambient p - lastP, i.e. the shortened move that was
+//actually made, and the exact gradient at y = 0. No rotation matrix, trigonometry or polar singularity is involved
+template<typename FuncT>
+class OnSphere final : public FunctionProducer
+{
+public:
+    OnSphere(FuncT func, double r, vect const& direction)
+       : FunctionProducer(func.nDims - 1), mFunc(move(func)), mR(r), mDirection(mFunc.nDims), mReflection(mFunc.nDims),
+         mGradPoint(mFunc.nDims), mInnerGrad(mFunc.nDims), mHasInnerGrad(false)
+    {
+        recenter(direction);
+    }
+
+    //moves the tangent space to the point along direction, reusing the storage of this view, so that an optimizer
+    //can follow its current point without allocating a new view at every step
+    void recenter(vect const& direction)
+    {
+        assert((size_t) direction.rows() == mFunc.nDims);
+
+        mDirection = direction / direction.norm();
+        //the last axis goes to whichever of -u and u is further from it, so that the normal is well conditioned
+        mReflection.setFromAxis(nDims, mDirection, mDirection(nDims) > 0 ? -1. : 1.);
+    }
+
+    double operator()(vect const& y) override
+    {
+        assert((size_t) y.rows() == nDims);
+
+        return statically(mFunc)(transform(y));
+    }
+
+    vect grad(vect const& y) override
+    {
+        assert((size_t) y.rows() == nDims);
+
+        return get<1>(valueGrad(y));
+    }
+
+    matrix hess(vect const& y) override
+    {
+        assert((size_t) y.rows() == nDims);
+
+        return get<2>(valueGradHess(y));
+    }
+
+    tuple<double, vect> valueGrad(vect const& y) override
+    {
+        auto result = evaluate(y, 1);
+        return make_tuple(result.value, move(result.grad));
+    };
+
+    tuple<double, vect, matrix> valueGradHess(vect const& y) override
+    {
+        auto result = evaluate(y, 2);
+        return make_tuple(result.value, move(result.grad), move(result.hess));
+    };
+
+    void evaluateInto(vect const& y, size_t order, Evaluation& result) override
+    {
+        assert((size_t) y.rows() == nDims);
+
+        Workspace::Frame frame;
+        auto& z = frame.getVect(0, mFunc.nDims);
+        fromTangentInto(y, z);
+        double norm = z.norm();
+
+        auto& x = frame.getVect(1, mFunc.nDims);
+        x = z * (mR / norm);
+
+        auto& inner = frame.getEvaluation(0, mFunc.nDims);
+        statically(mFunc).evaluateInto(x, order, inner);
+
+        result.value = inner.value;
+        if (order == 0)
+            return;
+
+        auto const& grad = inner.grad;
+        mGradPoint = x;
+        mInnerGrad = grad;
+        mHasInnerGrad = true;
+
+        auto& unit = frame.getVect(2, mFunc.nDims);
+        unit = z / norm;
+        double radial = grad.dot(unit);
+
+        auto& ambient = frame.getVect(3, mFunc.nDims);
+        ambient = (mR / norm) * (grad - radial * unit);
+        toTangentInto(ambient, result.grad);
+        if (order == 1)
+            return;
+
+        //Hessian of func(r z / |z|) with respect to z: the projected Hessian plus the curvature of the projection,
+        //with every outer product pair u a^T + a u^T folded into one rank-two update
+        auto& hessUnit = frame.getVect(4, mFunc.nDims);
+        hessUnit.noalias() = inner.hess * unit;
+        hessUnit -= (unit.dot(hessUnit) / 2) * unit;
+
+        auto& projected = frame.getMatrix(0, mFunc.nDims, mFunc.nDims);
+        projected = inner.hess;
+        projected.noalias() -= unit * hessUnit.transpose();
+        projected.noalias() -= hessUnit * unit.transpose();
+        projected *= sqr(mR / norm);
+
+        auto& curvature = frame.getVect(5, mFunc.nDims);
+        curvature = (mR / sqr(norm)) * (grad - 1.5 * radial * unit);
+        projected.noalias() -= curvature * unit.transpose();
+        projected.noalias() -= unit * curvature.transpose();
+        projected.diagonal().array() -= (mR / sqr(norm)) * radial;
+
+        mReflection.conjugateInPlace(projected, frame.getVect(6, mFunc.nDims), frame.getVect(7, mFunc.nDims));
+        result.hess = projected.topLeftCorner(nDims, nDims);
+    }
+
+    vect hessVec(vect const& y, vect const& v) override
+    {
+        assert((size_t) y.rows() == nDims);
+        assert((size_t) v.rows() == nDims);
+
+        vect z = fromTangent(y);
+        vect x = project(z);
+        vect direction = toAmbient(v);
+
+        double norm = z.norm();
+        vect unit = z / norm;
+        vect const& grad = innerGrad(x);
+        double radial = grad.dot(unit);
+
+        vect result = projectDirection(z, statically(mFunc).hessVec(x, projectDirection(z, direction)));
+        result -= (mR / sqr(norm)) * (grad * unit.dot(direction) + unit * grad.dot(direction));
+        result += (mR / sqr(norm)) * radial * (3 * unit * unit.dot(direction) - direction);
+        return toTangent(result);
+    }
+
+    vect transform(vect const& y) const
+    {
+        assert((size_t) y.rows() == nDims);
+
+        return project(fromTangent(y));
+    }
+
+    //transform into a caller-owned vector, without allocating once it has the size of the inner function
+    void transformInto(vect const& y, vect& x) const
+    {
+        assert((size_t) y.rows() == nDims);
+
+        x.resize(mFunc.nDims);
+        fromTangentInto(y, x);
+        x *= mR / x.norm();
+    }
+
+    vect fullTransform(vect const& y) const
+    {
+        return mFunc.fullTransform(transform(y));
+    }
+
+    FuncT const& getInnerFunction() const
+    {
+        return mFunc;
+    }
+
+    auto const& getFullInnerFunction() const
+    {
+        return mFunc.getFullInnerFunction();
+    }
+
+private:
+    FuncT mFunc;
+    double mR;
+    vect mDirection;
+    HouseholderReflection mReflection;
+
+    //gradient of func at the point of the last evaluation, which the Hessian-vector products of a Newton solve
+    //around that point need with every call
+    vect mGradPoint;
+    vect mInnerGrad;
+    bool mHasInnerGrad;
+
+    vect const& innerGrad(vect const& x)
+    {
+        if (!mHasInnerGrad || mGradPoint != x) {
+            mInnerGrad = statically(mFunc).grad(x);
+            mGradPoint = x;
+            mHasInnerGrad = true;
+        }
+        return mInnerGrad;
+    }
+
+    //Q y
+    vect toAmbient(vect const& y) const
+    {
+        vect padded(mFunc.nDims);
+        padded << y, 0.;
+        return mReflection.apply(padded);
+    }
+
+    //u + Q y
+    vect fromTangent(vect const& y) const
+    {
+        return mDirection + toAmbient(y);
+    }
+
+    void fromTangentInto(vect const& y, vect& z) const
+    {
+        z.head(nDims) = y;
+        z(nDims) = 0.;
+        mReflection.applyInPlace(z);
+        z += mDirection;
+    }
+
+    //Q^T v
+    vect toTangent(vect const& v) const
+    {
+        return mReflection.apply(v).head(nDims);
+    }
+
+    //Q^T v, reflecting v in place
+    void toTangentInto(vect& v, vect& tangent) const
+    {
+        mReflection.applyInPlace(v);
+        tangent = v.head(nDims);
+    }
+
+    vect project(vect const& z) const
+    {
+        return z * (mR / z.norm());
+    }
+
+    //Jacobian of project at z applied to v; it is symmetric, so it also takes gradients back
+    vect projectDirection(vect const& z, vect const& v) const
+    {
+        double norm = z.norm();
+        return (mR / norm) * (v - z * (z.dot(v) / sqr(norm)));
+    }
+};
+
+template<typename FuncT>
+auto makeOnSphere(FuncT&& func, double r, vect const& direction)
+{
+    return OnSphere<decay_t<FuncT>>(forward<FuncT>(func), r, direction);
+}
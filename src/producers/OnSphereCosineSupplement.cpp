@@ -26,14 +26,27 @@ matrix OnSphereCosineSupplement::hess(vect const& x)
 
 tuple<double, vect> OnSphereCosineSupplement::valueGrad(vect const& x)
 {
-    return FunctionProducer::valueGrad(x);
+    auto result = evaluate(x, 1);
+    return make_tuple(result.value, move(result.grad));
 };
 
 tuple<double, vect, matrix> OnSphereCosineSupplement::valueGradHess(vect const& x)
 {
-    return FunctionProducer::valueGradHess(x);
+    auto result = evaluate(x, 2);
+    return make_tuple(result.value, move(result.grad), move(result.hess));
 };
 
+void OnSphereCosineSupplement::evaluateInto(vect const& x, size_t order, Evaluation& result)
+{
+    double c = getCosine(x);
+    result.value = mValue * c * c * c;
+    if (order >= 1)
+        result.grad = (mValue * 3 * c * c) * mDirection;
+    if (order >= 2) {
+        result.hess.noalias() = mDirection * mDirection.transpose();
+        result.hess *= mValue * 6 * c;
+    }
+}
 
 double OnSphereCosineSupplement::getCosine(vect const& x) const
 {
@@ -0,0 +1,44 @@
+#include "PairPotentialCluster.h"
+
+vector<pair<size_t, size_t>> findPairs(vect const& x, double cutoff)
+{
+    size_t n = (size_t) x.rows() / 3;
+    vector<pair<size_t, size_t>> pairs;
+
+    if (cutoff <= 0) {
+        pairs.reserve(n * (n - 1) / 2);
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = i + 1; j < n; j++)
+                pairs.emplace_back(i, j);
+        return pairs;
+    }
+
+    Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic> const> positions(x.data(), 3, n);
+    Eigen::Vector3d lower = positions.rowwise().minCoeff();
+    Eigen::Vector3d extent = positions.rowwise().maxCoeff() - lower;
+
+    //cells are at least cutoff wide and there are no more of them than atoms, so the grid stays small
+    double cellSize = max(cutoff, cbrt((extent.array() + cutoff).prod() / max(n, (size_t) 1)));
+    Eigen::Array3i cells = ((extent / cellSize).array().floor() + 1).cast<int>();
+
+    vector<vector<size_t>> grid((size_t) cells.prod());
+    vector<Eigen::Array3i> atomCells(n);
+    for (size_t i = 0; i < n; i++) {
+        atomCells[i] = ((positions.col(i) - lower) / cellSize).array().floor().cast<int>().min(cells - 1);
+        auto const& c = atomCells[i];
+        grid[(c(0) * cells(1) + c(1)) * cells(2) + c(2)].push_back(i);
+    }
+
+    double cutoff2 = cutoff * cutoff;
+    for (size_t i = 0; i < n; i++) {
+        auto const& c = atomCells[i];
+        for (int a = max(c(0) - 1, 0); a <= min(c(0) + 1, cells(0) - 1); a++)
+            for (int b = max(c(1) - 1, 0); b <= min(c(1) + 1, cells(1) - 1); b++)
+                for (int d = max(c(2) - 1, 0); d <= min(c(2) + 1, cells(2) - 1); d++)
+                    for (size_t j : grid[(a * cells(1) + b) * cells(2) + d])
+                        if (i < j && (positions.col(i) - positions.col(j)).squaredNorm() < cutoff2)
+                            pairs.emplace_back(i, j);
+    }
+
+    return pairs;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "helper.h"
+
+#include "MoleculeProducer.h"
+#include "linearAlgebraUtils.h"
+
+//radial parts of pair potentials evaluated over whole arrays of squared distances at once. For every pair they
+//produce E(r), E'(r) / r and E''(r)
+struct LennardJones
+{
+    double epsilon = 1.;
+    double sigma = 1.;
+
+    void operator()(Eigen::ArrayXd const& r2, Eigen::ArrayXd& energy, Eigen::ArrayXd& first, Eigen::ArrayXd& second,
+                    size_t order) const
+    {
+        Eigen::ArrayXd s2 = sigma * sigma / r2;
+        Eigen::ArrayXd s6 = s2 * s2 * s2;
+        Eigen::ArrayXd s12 = s6 * s6;
+
+        energy = 4 * epsilon * (s12 - s6);
+        if (order >= 1)
+            first = -24 * epsilon * (2 * s12 - s6) / r2;
+        if (order >= 2)
+            second = 24 * epsilon * (26 * s12 - 7 * s6) / r2;
+    }
+};
+
+struct Morse
+{
+    double epsilon = 1.;
+    double r0 = 1.;
+    double rho = 6.;
+
+    void operator()(Eigen::ArrayXd const& r2, Eigen::ArrayXd& energy, Eigen::ArrayXd& first, Eigen::ArrayXd& second,
+                    size_t order) const
+    {
+        Eigen::ArrayXd r = r2.sqrt();
+        Eigen::ArrayXd x = (rho * (1 - r / r0)).exp();
+
+        energy = epsilon * x * (x - 2);
+        if (order >= 1)
+            first = -2 * epsilon * rho / r0 * x * (x - 1) / r;
+        if (order >= 2)
+            second = 2 * epsilon * sqr(rho / r0) * x * (2 * x - 1);
+    }
+};
+
+//pairs of atoms closer than cutoff, found with a cell list; all pairs if cutoff is not positive
+vector<pair<size_t, size_t>> findPairs(vect const& x, double cutoff);
+
+//cluster of identical atoms interacting through PotentialT. Pair terms are gathered into contiguous arrays and
+//evaluated by vectorized kernels; with a positive cutoff only pairs from neighbouring cells are considered and the
+//energy is shifted to vanish at the cutoff
+template<typename PotentialT>
+class PairPotentialCluster final : public MoleculeProducer
+{
+public:
+    PairPotentialCluster(vector<size_t> charges, PotentialT potential = PotentialT(), double cutoff = 0.)
+            : MoleculeProducer(move(charges)), mPotential(potential), mCutoff(cutoff), mShift(0.)
+    {
+        if (mCutoff > 0) {
+            Eigen::ArrayXd r2 = Eigen::ArrayXd::Constant(1, mCutoff * mCutoff), energy, first, second;
+            mPotential(r2, energy, first, second, 0);
+            mShift = energy(0);
+        }
+    }
+
+    double operator()(vect const& x) override
+    {
+        assert((size_t) x.rows() == nDims);
+
+        return get<0>(calculate(x, 0));
+    }
+
+    vect grad(vect const& x) override
+    {
+        return get<1>(valueGrad(x));
+    }
+
+    matrix hess(vect const& x) override
+    {
+        return get<2>(valueGradHess(x));
+    }
+
+    tuple<double, vect> valueGrad(vect const& x) override
+    {
+        assert((size_t) x.rows() == nDims);
+
+        auto result = calculate(x, 1);
+        return make_tuple(get<0>(result), move(get<1>(result)));
+    }
+
+    tuple<double, vect, matrix> valueGradHess(vect const& x) override
+    {
+        assert((size_t) x.rows() == nDims);
+
+        return calculate(x, 2);
+    }
+
+    //sum over pairs of 3x3 blocks applied to v, so the dense Hessian is never formed
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        assert((size_t) x.rows() == nDims);
+        assert((size_t) v.rows() == nDims);
+
+        auto pairs = findPairs(x, mCutoff);
+        size_t n = pairs.size();
+
+        Eigen::ArrayXd dx(n), dy(n), dz(n);
+        for (size_t k = 0; k < n; k++) {
+            size_t i = pairs[k].first * 3, j = pairs[k].second * 3;
+            dx(k) = x(i) - x(j);
+            dy(k) = x(i + 1) - x(j + 1);
+            dz(k) = x(i + 2) - x(j + 2);
+        }
+
+        Eigen::ArrayXd r2 = dx * dx + dy * dy + dz * dz;
+        Eigen::ArrayXd energy, first, second;
+        mPotential(r2, energy, first, second, 2);
+        Eigen::ArrayXd c = (second - first) / r2;
+
+        vect result = makeConstantVect(nDims, 0.);
+        for (size_t k = 0; k < n; k++) {
+            size_t i = pairs[k].first * 3, j = pairs[k].second * 3;
+
+            Eigen::Vector3d d(dx(k), dy(k), dz(k));
+            Eigen::Vector3d dv = v.segment<3>(i) - v.segment<3>(j);
+            Eigen::Vector3d product = c(k) * d.dot(dv) * d + first(k) * dv;
+
+            result.segment<3>(i) += product;
+            result.segment<3>(j) -= product;
+        }
+
+        return result;
+    }
+
+    vect optimize(vect const& structure) const override
+    {
+        auto cluster = *this;
+        return newtonMinimize(cluster, structure);
+    }
+
+    PairPotentialCluster const& getFullInnerFunction() const
+    {
+        return *this;
+    }
+
+    PairPotentialCluster& getFullInnerFunction()
+    {
+        return *this;
+    }
+
+private:
+    PotentialT mPotential;
+    double mCutoff;
+    double mShift;
+
+    tuple<double, vect, matrix> calculate(vect const& x, size_t order) const
+    {
+        auto pairs = findPairs(x, mCutoff);
+        size_t n = pairs.size();
+
+        Eigen::ArrayXd dx(n), dy(n), dz(n);
+        for (size_t k = 0; k < n; k++) {
+            size_t i = pairs[k].first * 3, j = pairs[k].second * 3;
+            dx(k) = x(i) - x(j);
+            dy(k) = x(i + 1) - x(j + 1);
+            dz(k) = x(i + 2) - x(j + 2);
+        }
+
+        Eigen::ArrayXd r2 = dx * dx + dy * dy + dz * dz;
+        Eigen::ArrayXd energy, first, second;
+        mPotential(r2, energy, first, second, order);
+
+        double value = energy.sum() - mShift * n;
+        vect grad = makeConstantVect(order >= 1 ? nDims : 0, 0.);
+        matrix hess = makeConstantMatrix(order >= 2 ? nDims : 0, order >= 2 ? nDims : 0, 0.);
+
+        if (order >= 1) {
+            Eigen::ArrayXd gx = first * dx, gy = first * dy, gz = first * dz;
+            for (size_t k = 0; k < n; k++) {
+                size_t i = pairs[k].first * 3, j = pairs[k].second * 3;
+                grad(i) += gx(k), grad(i + 1) += gy(k), grad(i + 2) += gz(k);
+                grad(j) -= gx(k), grad(j + 1) -= gy(k), grad(j + 2) -= gz(k);
+            }
+        }
+
+        if (order >= 2) {
+            Eigen::ArrayXd c = (second - first) / r2;
+            for (size_t k = 0; k < n; k++) {
+                size_t i = pairs[k].first * 3, j = pairs[k].second * 3;
+
+                Eigen::Vector3d d(dx(k), dy(k), dz(k));
+                Eigen::Matrix3d block = c(k) * d * d.transpose();
+                block.diagonal().array() += first(k);
+
+                hess.block<3, 3>(i, i) += block;
+                hess.block<3, 3>(j, j) += block;
+                hess.block<3, 3>(i, j) -= block;
+                hess.block<3, 3>(j, i) -= block;
+            }
+        }
+
+        return make_tuple(value, move(grad), move(hess));
+    }
+};
+
+using LennardJonesCluster = PairPotentialCluster<LennardJones>;
+using MorseCluster = PairPotentialCluster<Morse>;
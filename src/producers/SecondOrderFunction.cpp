@@ -4,6 +4,8 @@
 
 #include "SecondOrderFunction.h"
 
+#include "Workspace.h"
+
 SecondOrderFunction::SecondOrderFunction(double value, vect grad, matrix hess) :
    FunctionProducer(grad.size()), mValue(value), mGrad(move(grad)), mHess(move(hess))
 {
@@ -27,11 +29,26 @@ matrix SecondOrderFunction::hess(vect const& x)
 
 tuple<double, vect> SecondOrderFunction::valueGrad(vect const& x)
 {
-    return FunctionProducer::valueGrad(x);
+    auto result = evaluate(x, 1);
+    return make_tuple(result.value, move(result.grad));
 };
 
 tuple<double, vect, matrix> SecondOrderFunction::valueGradHess(vect const& x)
 {
-    return FunctionProducer::valueGradHess(x);
+    auto result = evaluate(x, 2);
+    return make_tuple(result.value, move(result.grad), move(result.hess));
 };
 
+
+void SecondOrderFunction::evaluateInto(vect const& x, size_t order, Evaluation& result)
+{
+    Workspace::Frame frame;
+    auto& hessX = frame.getVect(0, nDims);
+    hessX.noalias() = mHess * x;
+
+    result.value = mValue + x.dot(mGrad) + .5 * x.dot(hessX);
+    if (order >= 1)
+        result.grad = mGrad + hessX;
+    if (order >= 2)
+        result.hess = mHess;
+}
@@ -14,6 +14,7 @@ public:
 
     tuple<double, vect> valueGrad(vect const& x);
     tuple<double, vect, matrix> valueGradHess(vect const& x);
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override;
 
 
 private:
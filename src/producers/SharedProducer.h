@@ -0,0 +1,107 @@
+#pragma once
+
+#include "helper.h"
+
+#include "FunctionProducer.h"
+
+//a handle to one producer that all of its copies share, so copying it is a reference count increment where copying
+//the producer itself would copy bases, shifts and charges. Views rebuilt around a long-lived producer on every
+//iteration, such as makeOnSphere(func, r, p) in the sphere optimizers, wrap share(func) instead of func. The shared
+//producer is used as it was when shared: it is never copied again, and is not reached through other copies of func
+template<typename FuncT>
+class SharedProducer final : public FunctionProducer
+{
+public:
+    explicit SharedProducer(shared_ptr<FuncT> func) : FunctionProducer(func->nDims), mFunc(move(func))
+    { }
+
+    double operator()(vect const& x) override
+    {
+        return statically(*mFunc)(x);
+    }
+
+    vect grad(vect const& x) override
+    {
+        return statically(*mFunc).grad(x);
+    }
+
+    matrix hess(vect const& x) override
+    {
+        return statically(*mFunc).hess(x);
+    }
+
+    tuple<double, vect> valueGrad(vect const& x) override
+    {
+        return statically(*mFunc).valueGrad(x);
+    }
+
+    tuple<double, vect, matrix> valueGradHess(vect const& x) override
+    {
+        return statically(*mFunc).valueGradHess(x);
+    }
+
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        statically(*mFunc).evaluateInto(x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        return statically(*mFunc).hessVec(x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        return statically(*mFunc).evaluateBatch(xs, order);
+    }
+
+    //the shared producer is the leaf, so every handle to it is merged into one term
+    void collectLinearTerms(double factor, vector<LinearTerm>& terms) override
+    {
+        statically(*mFunc).collectLinearTerms(factor, terms);
+    }
+
+    vect fullTransform(vect const& x) const
+    {
+        return mFunc->fullTransform(x);
+    }
+
+    FuncT const& getInnerFunction() const
+    {
+        return *mFunc;
+    }
+
+    auto const& getFullInnerFunction() const
+    {
+        return mFunc->getFullInnerFunction();
+    }
+
+private:
+    shared_ptr<FuncT> mFunc;
+};
+
+//like FixFusion: sharing a handle again gives a copy of the handle
+template<typename FuncT>
+struct Sharing
+{
+    template<typename FuncArgT>
+    static auto make(FuncArgT&& func)
+    {
+        return SharedProducer<FuncT>(make_shared<FuncT>(forward<FuncArgT>(func)));
+    }
+};
+
+template<typename FuncT>
+struct Sharing<SharedProducer<FuncT>>
+{
+    static auto make(SharedProducer<FuncT> const& func)
+    {
+        return func;
+    }
+};
+
+template<typename FuncT>
+auto share(FuncT&& func)
+{
+    return Sharing<decay_t<FuncT>>::make(forward<FuncT>(func));
+}
@@ -20,10 +20,21 @@ matrix SqrNorm::hess(vect const& x)
 
 tuple<double, vect> SqrNorm::valueGrad(vect const& x)
 {
-    return FunctionProducer::valueGrad(x);
+    auto result = evaluate(x, 1);
+    return make_tuple(result.value, move(result.grad));
 };
 
 tuple<double, vect, matrix> SqrNorm::valueGradHess(vect const& x)
 {
-    return FunctionProducer::valueGradHess(x);
+    auto result = evaluate(x, 2);
+    return make_tuple(result.value, move(result.grad), move(result.hess));
 };
+
+void SqrNorm::evaluateInto(vect const& x, size_t order, Evaluation& result)
+{
+    result.value = x.squaredNorm();
+    if (order >= 1)
+        result.grad = 2 * x;
+    if (order >= 2)
+        result.hess = 2. * matrix::Identity(x.rows(), x.rows());
+}
@@ -14,4 +14,5 @@ public:
     matrix hess(vect const& x) override;
     tuple<double, vect> valueGrad(vect const& x) override;
     tuple<double, vect, matrix> valueGradHess(vect const& x) override;
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override;
 };
@@ -3,9 +3,10 @@
 #include "helper.h"
 
 #include "FunctionProducer.h"
+#include "LinearTerms.h"
 
 template<typename Func1T, typename Func2T>
-class Sum : public FunctionProducer
+class Sum final : public FunctionProducer
 {
 public:
     Sum(Func1T func1, Func2T func2) : FunctionProducer(func1.nDims), mFunc1(move(func1)), mFunc2(move(func2))
@@ -15,35 +16,50 @@ public:
 
     double operator()(vect const& x) override
     {
-        return mFunc1(x) + mFunc2(x);
+        return linearValue(linearTerms(*this), x);
     }
 
     vect grad(vect const& x) override
     {
-        return mFunc1.grad(x) + mFunc2.grad(x);
+        return linearGrad(linearTerms(*this), x);
     }
 
     matrix hess(vect const& x) override
     {
-        return mFunc1.hess(x) + mFunc2.hess(x);
+        return linearHess(linearTerms(*this), x);
     };
 
     tuple<double, vect> valueGrad(vect const& x) override
     {
-        auto first  = mFunc1.valueGrad(x);
-        auto second = mFunc2.valueGrad(x);
-
-        return make_tuple(get<0>(first) + get<0>(second), get<1>(first) + get<1>(second));
+        return linearValueGrad(linearTerms(*this), x);
     };
 
     tuple<double, vect, matrix> valueGradHess(vect const& x) override
     {
-        auto first  = mFunc1.valueGradHess(x);
-        auto second = mFunc2.valueGradHess(x);
-
-        return make_tuple(get<0>(first) + get<0>(second), get<1>(first) + get<1>(second), get<2>(first) + get<2>(second));
+        return linearValueGradHess(linearTerms(*this), x);
     };
 
+    void evaluateInto(vect const& x, size_t order, Evaluation& result) override
+    {
+        linearEvaluateInto(*this, x, order, result);
+    }
+
+    vect hessVec(vect const& x, vect const& v) override
+    {
+        return linearHessVec(linearTerms(*this), x, v);
+    }
+
+    BatchResult evaluateBatch(matrix const& xs, size_t order) override
+    {
+        return linearEvaluateBatch(linearTerms(*this), xs, order);
+    }
+
+    void collectLinearTerms(double factor, vector<LinearTerm>& terms) override
+    {
+        statically(mFunc1).collectLinearTerms(factor, terms);
+        statically(mFunc2).collectLinearTerms(factor, terms);
+    }
+
 private:
     Func1T mFunc1;
     Func2T mFunc2;
@@ -0,0 +1,63 @@
+#include "Workspace.h"
+
+Workspace::Frame::Frame() : mWorkspace(Workspace::local()), mBuffers(mWorkspace.open())
+{ }
+
+Workspace::Frame::~Frame()
+{
+    mWorkspace.close();
+}
+
+vect& Workspace::Frame::getVect(size_t i, size_t rows)
+{
+    for (auto& buffer : mBuffers.vects)
+        if (get<0>(buffer) == i && get<1>(buffer) == rows)
+            return get<2>(buffer);
+
+    mBuffers.vects.emplace_back(i, rows, vect(rows));
+    return get<2>(mBuffers.vects.back());
+}
+
+matrix& Workspace::Frame::getMatrix(size_t i, size_t rows, size_t cols)
+{
+    for (auto& buffer : mBuffers.matrices)
+        if (get<0>(buffer) == i && get<1>(buffer) == rows && get<2>(buffer) == cols)
+            return get<3>(buffer);
+
+    mBuffers.matrices.emplace_back(i, rows, cols, matrix(rows, cols));
+    return get<3>(mBuffers.matrices.back());
+}
+
+Evaluation& Workspace::Frame::getEvaluation(size_t i, size_t nDims)
+{
+    for (auto& buffer : mBuffers.evaluations)
+        if (get<0>(buffer) == i && get<1>(buffer) == nDims)
+            return get<2>(buffer);
+
+    mBuffers.evaluations.emplace_back(i, nDims, Evaluation());
+    return get<2>(mBuffers.evaluations.back());
+}
+
+vector<LinearTerm>& Workspace::Frame::getTerms()
+{
+    return mBuffers.terms;
+}
+
+Workspace& Workspace::local()
+{
+    static thread_local Workspace workspace;
+    return workspace;
+}
+
+Workspace::Buffers& Workspace::open()
+{
+    if (mDepth == mFrames.size())
+        mFrames.push_back(make_unique<Buffers>());
+    return *mFrames[mDepth++];
+}
+
+void Workspace::close()
+{
+    assert(mDepth > 0);
+    mDepth--;
+}
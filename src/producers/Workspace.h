@@ -0,0 +1,59 @@
+#pragma once
+
+#include "helper.h"
+
+#include <deque>
+
+#include "FunctionProducer.h"
+
+//per-thread stack of reusable buffers for FunctionProducer::evaluateInto. A producer opens a Frame for the duration of
+//its call and takes its temporaries from it. The frame at a given nesting depth is handed out again on the next call,
+//and its buffers are kept per slot and shape, so once a stack of producers has been evaluated later evaluations of
+//the same stack do not touch the heap even when producers of different sizes take turns at one depth
+class Workspace
+{
+private:
+    struct Buffers
+    {
+        deque<tuple<size_t, size_t, vect>> vects;
+        deque<tuple<size_t, size_t, size_t, matrix>> matrices;
+        deque<tuple<size_t, size_t, Evaluation>> evaluations;
+        vector<LinearTerm> terms;
+    };
+
+public:
+    class Frame
+    {
+    public:
+        Frame();
+        ~Frame();
+
+        Frame(Frame const&) = delete;
+        Frame& operator=(Frame const&) = delete;
+
+        //the i-th buffer of each kind of this frame with the given shape; references stay valid until the frame is
+        //closed. An evaluation is keyed by the dimension of the producer evaluated into it
+        vect& getVect(size_t i, size_t rows);
+        matrix& getMatrix(size_t i, size_t rows, size_t cols);
+        Evaluation& getEvaluation(size_t i, size_t nDims);
+        vector<LinearTerm>& getTerms();
+
+    private:
+        Workspace& mWorkspace;
+        Buffers& mBuffers;
+    };
+
+    Workspace() = default;
+
+    Workspace(Workspace const&) = delete;
+    Workspace& operator=(Workspace const&) = delete;
+
+    static Workspace& local();
+
+private:
+    vector<unique_ptr<Buffers>> mFrames;
+    size_t mDepth = 0;
+
+    Buffers& open();
+    void close();
+};
@@ -7,14 +7,19 @@
 #include "MultipliedByConstant.h"
 
 #include "InPolar.h"
+#include "OnSphere.h"
 #include "LagrangeMultiplier.h"
 #include "AffineTransformation.h"
 #include "FixValues.h"
+#include "SharedProducer.h"
 
 #include "SqrNorm.h"
 #include "Constant.h"
 #include "ModelFunction.h"
+#include "MoleculeProducer.h"
 #include "GaussianProducer.h"
+#include "MorseMolecule.h"
+#include "PairPotentialCluster.h"
 #include "OnSphereCosineSupplement.h"
 #include "Cosine3OnSphereInterpolation.h"
 #include "ClosestCosine3OnSphere.h"
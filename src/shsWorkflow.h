@@ -7,25 +7,32 @@
 #include "linearAlgebraUtils.h"
 #include "functionLoggers.h"
 #include "producers/GaussianProducer.h"
+#include "gaussian/BackendUsage.h"
 #include "normalCoordinates.h"
 #include "inputOutputUtils.h"
 #include "optimization/optimizations.h"
 
 using namespace optimization;
 
-template<typename StopStrategyT>
-optional<vect> secondOrderStructureOptimization(StopStrategyT stopStrategy, GaussianProducer& molecule, vect structure,
+template<typename StopStrategyT, typename MoleculeT>
+optional<vect> secondOrderStructureOptimization(StopStrategyT stopStrategy, MoleculeT& molecule, vect structure,
                                                 size_t iterLimit) {
     for (size_t iter = 0; iter != iterLimit; ++iter) {
         auto fixed = remove6LesserHessValues2(molecule, structure);
-        auto valueGradHess = fixed.valueGradHess(makeConstantVect(fixed.nDims, 0.));
+
+        //this Hessian only shapes the Newton step; the caller checks the result with an exact one
+        tuple<double, vect, matrix> valueGradHess;
+        {
+            HessianReuseScope reuse;
+            valueGradHess = fixed.valueGradHess(makeConstantVect(fixed.nDims, 0.));
+        }
 
         auto value = get<0>(valueGradHess);
         auto grad = get<1>(valueGradHess);
         auto hess = get<2>(valueGradHess);
 
         auto memStruct = structure;
-        structure = fixed.fullTransform(-hess.inverse() * grad);
+        structure = fixed.fullTransform(newtonStep(hess, grad));
 
         if (stopStrategy(iter, structure, value, grad, hess, structure - memStruct))
             return make_optional(structure);
@@ -35,7 +42,9 @@ optional<vect> secondOrderStructureOptimization(StopStrategyT stopStrategy, Gaus
 }
 
 
-optional<vect> tryToOptimizeTS(GaussianProducer& molecule, vect structure, size_t iters = 10) {
+template<typename MoleculeT>
+optional<vect> tryToOptimizeTS(MoleculeT& molecule, vect structure, size_t iters = 10) {
+    UsageStage stage("tryToOptimizeTS");
     try {
         auto stopStrategy = makeHistoryStrategy(StopStrategy(1e-4, 1e-4));
         //todo: think about singular values check on each iteration of optimization
@@ -69,7 +78,8 @@ optional<vect> tryToOptimizeTS(GaussianProducer& molecule, vect structure, size_
 }
 
 
-optional<vect> shsTSTryRoutine(GaussianProducer& molecule, vect const& structure, ostream& output) {
+template<typename MoleculeT>
+optional<vect> shsTSTryRoutine(MoleculeT& molecule, vect const& structure, ostream& output) {
     if (auto ts = tryToOptimizeTS(molecule, structure)) {
         auto valueGradHess = molecule.valueGradHess(*ts);
         auto grad = get<1>(valueGradHess);
@@ -91,6 +101,7 @@ optional<vect> shsTSTryRoutine(GaussianProducer& molecule, vect const& structure
 template<typename FuncT>
 tuple<vector<vect>, optional<vect>>
 shsPath(FuncT&& func, vect direction, size_t pathNumber, double deltaR, size_t convIterLimit) {
+    UsageStage stage("shsPath");
     auto& molecule = func.getFullInnerFunction();
     LOG_INFO("Path #{}. R0 = {}. Initial direction: {}", pathNumber, direction.norm(), direction.transpose());
 
@@ -181,7 +192,7 @@ shsPath(FuncT&& func, vect direction, size_t pathNumber, double deltaR, size_t c
 template<typename FuncT>
 void shs(FuncT&& func) {
     auto& molecule = func.getFullInnerFunction();
-    molecule.setGaussianNProc(3);
+    molecule.setNProc(3);
     logFunctionInfo(func, makeConstantVect(func.nDims, 0), "normalized energy for equil structure");
 
     ifstream minsOnSphere("./mins_on_sphere");
@@ -203,7 +214,8 @@ void shs(FuncT&& func) {
 
 template<typename FuncT>
 vector<vect> minimaElimination(FuncT&& func) {
-    func.getFullInnerFunction().setGaussianNProc(3);
+    UsageStage stage("minimaElimination");
+    func.getFullInnerFunction().setNProc(3);
     auto zeroEnergy = func(makeConstantVect(func.nDims, 0));
 
     double const r = .05;
@@ -368,7 +380,8 @@ vector<vect> minimaElimination(FuncT&& func) {
     }
 }
 
-tuple<vector<vect>, optional<vect>> goDown(GaussianProducer& molecule, vect structure) {
+template<typename MoleculeT>
+tuple<vector<vect>, optional<vect>> goDown(MoleculeT& molecule, vect structure) {
     vector<vect> path;
     for (size_t step = 0; step < 300; step++) {
         auto fixed = remove6LesserHessValues2(molecule, structure);
@@ -394,7 +407,8 @@ tuple<vector<vect>, optional<vect>> goDown(GaussianProducer& molecule, vect stru
 }
 
 
-tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTSOld(GaussianProducer& molecule, vect const& structure) {
+template<typename MoleculeT>
+tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTSOld(MoleculeT& molecule, vect const& structure) {
     auto fixed = remove6LesserHessValues2(molecule, structure);
 
     auto hess = fixed.hess(makeConstantVect(fixed.nDims, 0));
@@ -424,7 +438,8 @@ tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTSOld(GaussianProducer
     }
 }
 
-optional<vect> optimize(GaussianProducer& molecule, vect const& structure)
+template<typename MoleculeT>
+optional<vect> tryToOptimize(MoleculeT& molecule, vect const& structure)
 {
     try {
         return molecule.optimize(structure);
@@ -435,7 +450,9 @@ optional<vect> optimize(GaussianProducer& molecule, vect const& structure)
     }
 }
 
-tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTS(GaussianProducer& molecule, vect const& structure) {
+template<typename MoleculeT>
+tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTS(MoleculeT& molecule, vect const& structure) {
+    UsageStage stage("twoWayTS");
     auto fixed = remove6LesserHessValues2(molecule, structure);
 
     auto hess = fixed.hess(makeConstantVect(fixed.nDims, 0));
@@ -451,8 +468,8 @@ tuple<vector<vect>, optional<vect>, optional<vect>> twoWayTS(GaussianProducer& m
             auto first = fixed.fullTransform(-FACTOR * v);
             auto second = fixed.fullTransform(FACTOR * v);
 
-            optional<vect> firstES = optimize(molecule, first);
-            optional<vect> secondES = optimize(molecule, second);
+            optional<vect> firstES = tryToOptimize(molecule, first);
+            optional<vect> secondES = tryToOptimize(molecule, second);
 
             vector<vect> path;
             if (firstES)
@@ -530,7 +547,8 @@ vector<vect> readTmp() {
     return result;
 }
 
-void workflow(GaussianProducer& molecule, vect const& initialStruct, double deltaR, size_t iterLimit) {
+template<typename MoleculeT>
+void workflow(MoleculeT& molecule, vect const& initialStruct, double deltaR, size_t iterLimit) {
     system("mkdir -p info_logs es_directions paths shs_intermediate_log");
 
     vector<spdlog::sink_ptr> sinks = {make_shared<spdlog::sinks::daily_file_sink_st>("info_logs/log", 0, 0)};
@@ -543,6 +561,10 @@ void workflow(GaussianProducer& molecule, vect const& initialStruct, double delt
     ofstream esOutput("./equilibrium_structures.xyz");
     ofstream tsOutput("./transition_state_structures.xyz");
 
+    //QM jobs spent per stage so far, rewritten every ten minutes and once more when the run is over
+    auto& usage = molecule.getUsage();
+    usage.startPeriodicDump("./backend_usage.json", 600);
+
     auto const& charges = molecule.getCharges();
 
     StructureSet uniqueESs(1e-3);
@@ -597,7 +619,7 @@ void workflow(GaussianProducer& molecule, vect const& initialStruct, double delt
         for (auto const& direction : minimaDirections)
             esDirsOutput << print(direction, 17) << endl;
 
-        inNormalCoords.getFullInnerFunction().setGaussianNProc(1);
+        inNormalCoords.getFullInnerFunction().setNProc(1);
         #pragma omp parallel for
         for (size_t i = 0; i < minimaDirections.size(); i++) {
             vector<vect> path;
@@ -609,10 +631,16 @@ void workflow(GaussianProducer& molecule, vect const& initialStruct, double delt
                 #pragma omp critical
                 isUniqueTS = uniqueTSs.addStructure(*ts);
                 if (isUniqueTS) {
+                    matrix tsHess;
+                    {
+                        UsageStage stage("tsVerification");
+                        tsHess = molecule.hess(*ts);
+                    }
+
                     #pragma omp critical
                     {
                         infoLogger->info("Found new TS:{}\nsingular values: {}\nchemcraft:\n{}", print(*ts),
-                                         singularValues(molecule.hess(*ts)), toChemcraftCoords(charges, *ts));
+                                         singularValues(tsHess), toChemcraftCoords(charges, *ts));
                         tsOutput << toChemcraftCoords(charges, *ts, to_string(uniqueTSs.size())) << flush;
                     }
 
@@ -644,4 +672,11 @@ void workflow(GaussianProducer& molecule, vect const& initialStruct, double delt
 
         shsPathCounter += minimaDirections.size();
     }
+
+    usage.stopPeriodicDump();
+    infoLogger->info("Backend usage:\n{}", usage.toJson());
+
+    auto statistics = molecule.getStatistics();
+    if (!statistics.empty())
+        infoLogger->info("Backend statistics:\n{}", statistics);
 }
\ No newline at end of file
@@ -3,6 +3,20 @@
 #include <gtest/gtest.h>
 
 #include "producers/producers.h"
+#include "optimization/stop_strategies/AtomicStopStrategy.h"
+#include "gaussian/EvaluationCache.h"
+#include "gaussian/ResultStore.h"
+#include "gaussian/JobPool.h"
+#include "gaussian/FchkParser.h"
+#include "gaussian/ScratchManager.h"
+#include "gaussian/ProcessLauncher.h"
+#include "gaussian/CheckpointHistory.h"
+#include "gaussian/HessianHistory.h"
+#include "gaussian/BackendUsage.h"
+#include "optimization/KrylovSolvers.h"
+#include "optimization/optimizeOnSphere.h"
+#include "FixedDimensions.h"
+#include "normalCoordinates.h"
 
 vect getRandomPoint(vect const& lowerBound, vect const& upperBound)
 {
@@ -10,6 +24,20 @@ vect getRandomPoint(vect const& lowerBound, vect const& upperBound)
     return lowerBound.array() + p.array() * (upperBound.array() - lowerBound.array());
 }
 
+//planar ethylene, C C H H H H, close to the equilibrium of MorseMolecule
+vect makeEthylene()
+{
+    return makeVect(0.000, 0.000, 0.000, 1.330, 0.000, 0.000, -0.574, 0.922, 0.000, -0.574, -0.922, 0.000,
+                    1.903, 0.922, 0.000, 1.903, -0.922, 0.000);
+}
+
+//ethylene on MorseMolecule with its symmetry fixed, in normalized coordinates around makeEthylene()
+auto makeNormalizedEthylene()
+{
+    auto fixed = fixAtomSymmetry(MorseMolecule({6, 6, 1, 1, 1, 1}));
+    return normalizeForPolar(fixed, fixed.backTransform(makeEthylene()));
+}
+
 template<typename FuncT>
 void testGradient(FuncT& func, vect const& lowerBound, vect const& upperBound, size_t iters, double delta = 1e-5,
                   double eps = 1e-5)
@@ -111,6 +139,34 @@ TEST(FunctionProducer, AffineTransformation)
     testProducer(normalizeForPolar(type(), b), lowerBound, upperBound, 1000);
 }
 
+TEST(FunctionProducer, HouseholderRotation)
+{
+    auto normalized = makeNormalizedEthylene();
+
+    auto from = eye(normalized.nDims, normalized.nDims - 1);
+    ASSERT_LE((HouseholderRotation(from, from).toMatrix() - identity(normalized.nDims)).norm(), 1e-15);
+
+    for (size_t i = 0; i < 5; i++) {
+        vect to = makeRandomVect(normalized.nDims) - makeConstantVect(normalized.nDims, .5);
+        auto rotation = HouseholderRotation(from, to);
+        matrix dense = rotationMatrix(from, to);
+        ASSERT_LE((rotation.toMatrix() - dense).norm(), 1e-12);
+
+        auto rotated = makeAffineTransfomation(normalized, rotation);
+        auto denseRotated = makeAffineTransfomation(normalized, dense);
+
+        vect x = makeRandomVect(normalized.nDims) * .2;
+        auto v = makeRandomVect(normalized.nDims);
+        auto valueGradHess = rotated.valueGradHess(x);
+        auto denseValueGradHess = denseRotated.valueGradHess(x);
+        ASSERT_LE(abs(get<0>(valueGradHess) - get<0>(denseValueGradHess)), 1e-12);
+        ASSERT_LE((get<1>(valueGradHess) - get<1>(denseValueGradHess)).norm(), 1e-10);
+        ASSERT_LE((get<2>(valueGradHess) - get<2>(denseValueGradHess)).norm(), 1e-9);
+        ASSERT_LE((rotated.hessVec(x, v) - get<2>(valueGradHess) * v).norm(), 1e-9);
+        ASSERT_LE((rotated.backTransform(rotated.transform(x)) - x).norm(), 1e-12);
+    }
+}
+
 TEST(FunctionProducer, InPolar)
 {
     using FunctionType = ModelFunction;
@@ -121,6 +177,37 @@ TEST(FunctionProducer, InPolar)
     auto upperBound = makeConstantVect(1, 2 * M_PI);
 
     testProducer(makePolar(FunctionType(), 1.313), lowerBound, upperBound, 100);
+
+    auto polar = makePolar(makeNormalizedEthylene(), .3);
+
+    testProducer(polar, makeConstantVect(polar.nDims, 0.), makeConstantVect(polar.nDims, 2 * M_PI), 3, 1e-4, 1e-5);
+}
+
+TEST(FunctionProducer, OnSphere)
+{
+    auto normalized = makeNormalizedEthylene();
+
+    for (size_t i = 0; i < 5; i++) {
+        vect direction = makeRandomVect(normalized.nDims) - makeConstantVect(normalized.nDims, .5);
+        auto onSphere = makeOnSphere(normalized, .3, direction);
+        auto polar = makePolarWithDirection(normalized, .3, direction);
+
+        auto lowerBound = makeConstantVect(onSphere.nDims, -.3);
+        auto upperBound = makeConstantVect(onSphere.nDims, .3);
+        testProducer(onSphere, lowerBound, upperBound, 1, 1e-5, 1e-5);
+
+        auto y = getRandomPoint(lowerBound, upperBound);
+        auto v = makeRandomVect(onSphere.nDims);
+        ASSERT_LE((onSphere.hessVec(y, v) - onSphere.hess(y) * v).norm(), 1e-9 * onSphere.hess(y).norm());
+        ASSERT_LE(abs(onSphere.transform(y).norm() - .3), 1e-12);
+        ASSERT_NEAR(acos(angleCosine(onSphere.transform(y), direction)), atan(y.norm()), 1e-9);
+
+        auto tangent = onSphere.valueGradHess(makeConstantVect(onSphere.nDims, 0.));
+        auto angular = polar.valueGradHess(makeConstantVect(polar.nDims, M_PI / 2));
+        ASSERT_LE(abs(get<0>(tangent) - get<0>(angular)), 1e-12);
+        ASSERT_LE(abs(get<1>(tangent).norm() - get<1>(angular).norm()), 1e-9);
+        ASSERT_LE((singularValues(get<2>(tangent)) - singularValues(get<2>(angular))).norm(), 1e-9);
+    }
 }
 
 TEST(FunctionProducer, GaussianProducer)
@@ -141,6 +228,400 @@ TEST(FunctionProducer, GaussianProducer_2)
 }
 
 
+TEST(FunctionProducer, GaussianFiniteDifferenceHessian)
+{
+    GaussianProducer molecule({8, 1, 1});
+    auto x = makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.);
+
+    auto analytic = molecule.valueGradHess(x);
+    auto finiteDifference = molecule.finiteDifferenceValueGradHess(x);
+
+    ASSERT_LE(abs(get<0>(analytic) - get<0>(finiteDifference)), 1e-9);
+    ASSERT_LE((get<1>(analytic) - get<1>(finiteDifference)).norm(), 1e-9);
+    ASSERT_LE((get<2>(analytic) - get<2>(finiteDifference)).norm(), 1e-3 * get<2>(analytic).norm());
+    ASSERT_EQ(molecule.getJobTimings().count(FORCE_METHOD, 1), 12u);
+}
+
+TEST(FunctionProducer, MorseMolecule)
+{
+    MorseMolecule molecule({6, 6, 1, 1, 1, 1});
+    auto structure = makeEthylene();
+
+    testProducer(molecule, structure.array() - .1, structure.array() + .1, 10, 1e-4, 1e-5);
+
+    auto optimized = molecule.optimize(structure);
+    ASSERT_LT(molecule.grad(optimized).norm(), 1e-8);
+    ASSERT_LT(molecule(optimized), molecule(structure));
+
+    auto fixed = fixAtomSymmetry(molecule);
+    auto fixedStructure = fixed.backTransform(structure);
+    testProducer(fixed, fixedStructure.array() - .1, fixedStructure.array() + .1, 5, 1e-4, 1e-5);
+    ASSERT_EQ(&optimization::StackExtractor<decltype(fixed)>::extractAtomicFunc(fixed), &fixed.getFullInnerFunction());
+}
+
+vect makeLatticeCluster(size_t side, double spacing, double noise)
+{
+    vect x(side * side * side * 3);
+    for (size_t i = 0; i < side; i++)
+        for (size_t j = 0; j < side; j++)
+            for (size_t k = 0; k < side; k++)
+                x.segment<3>(((i * side + j) * side + k) * 3) = Eigen::Vector3d(i, j, k) * spacing;
+    return x + noise * makeRandomVect(x.rows());
+}
+
+TEST(FunctionProducer, PairPotentialCluster)
+{
+    auto x = makeLatticeCluster(2, 1.1, .1);
+    vector<size_t> charges(8, 18);
+
+    testProducer(LennardJonesCluster(charges), x.array() - .05, x.array() + .05, 3, 1e-5, 1e-4);
+    testProducer(MorseCluster(charges), x.array() - .05, x.array() + .05, 3, 1e-5, 1e-4);
+    testProducer(MorseCluster(charges, Morse(), 1.5), x.array() - .05, x.array() + .05, 3, 1e-5, 1e-4);
+
+    LennardJonesCluster cluster(charges);
+    auto optimized = cluster.optimize(x);
+    ASSERT_LT(cluster.grad(optimized).norm(), 1e-8);
+    ASSERT_LT(cluster(optimized), cluster(x));
+}
+
+TEST(FunctionProducer, PairPotentialClusterCellList)
+{
+    auto x = makeLatticeCluster(6, 1.1, .2);
+    size_t n = (size_t) x.rows() / 3;
+
+    for (double cutoff : {.5, 1.3, 2.5, 100.}) {
+        set<pair<size_t, size_t>> expected;
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = i + 1; j < n; j++)
+                if ((x.segment<3>(i * 3) - x.segment<3>(j * 3)).norm() < cutoff)
+                    expected.emplace(i, j);
+
+        auto pairs = findPairs(x, cutoff);
+        set<pair<size_t, size_t>> found(pairs.begin(), pairs.end());
+        ASSERT_EQ(found, expected);
+    }
+
+    vector<size_t> charges(n, 18);
+    MorseCluster full(charges), truncated(charges, Morse(), 100.);
+    auto fullValueGradHess = full.valueGradHess(x);
+    auto truncatedValueGradHess = truncated.valueGradHess(x);
+    ASSERT_NEAR(get<0>(fullValueGradHess), get<0>(truncatedValueGradHess), 1e-9);
+    ASSERT_LT((get<1>(fullValueGradHess) - get<1>(truncatedValueGradHess)).norm(), 1e-9);
+    ASSERT_LT((get<2>(fullValueGradHess) - get<2>(truncatedValueGradHess)).norm(), 1e-9);
+}
+
+TEST(FunctionProducer, HessVec)
+{
+    auto polar = makePolar(makeNormalizedEthylene(), .3);
+    auto sum = Sum<decltype(polar), decltype(polar)>(polar, polar);
+
+    for (size_t i = 0; i < 10; i++) {
+        auto phi = getRandomPoint(makeConstantVect(polar.nDims, 0.), makeConstantVect(polar.nDims, 2 * M_PI));
+        auto v = makeRandomVect(polar.nDims);
+
+        ASSERT_LE((polar.hessVec(phi, v) - polar.hess(phi) * v).norm(), 1e-9 * (1 + polar.hess(phi).norm()));
+        ASSERT_LE((sum.hessVec(phi, v) - sum.hess(phi) * v).norm(), 1e-9 * (1 + sum.hess(phi).norm()));
+    }
+
+    auto x = makeLatticeCluster(3, 1.1, .1);
+    MorseCluster cluster(vector<size_t>((size_t) x.rows() / 3, 18), Morse(), 2.);
+    auto v = makeRandomVect(x.rows());
+    ASSERT_LE((cluster.hessVec(x, v) - cluster.hess(x) * v).norm(), 1e-9 * cluster.hess(x).norm());
+}
+
+TEST(FunctionProducer, GaussianHessVec)
+{
+    GaussianProducer molecule({8, 1, 1});
+    auto x = makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.);
+    auto v = makeRandomVect(9);
+
+    auto finiteDifference = molecule.hessVec(x, v);
+    ASSERT_EQ(molecule.getJobTimings().count(FORCE_METHOD, 1), 2u);
+
+    auto hess = molecule.hess(x);
+    ASSERT_LE((finiteDifference - hess * v).norm(), 1e-3 * hess.norm() * v.norm());
+    ASSERT_LE((molecule.hessVec(x, v) - hess * v).norm(), 1e-9);
+}
+
+template<typename FuncT>
+void testBatch(FuncT& func, matrix const& xs, double eps)
+{
+    for (size_t order = 0; order <= 2; order++) {
+        auto batch = func.evaluateBatch(xs, order);
+        ASSERT_EQ((size_t) batch.values.size(), (size_t) xs.cols());
+        ASSERT_EQ(batch.hesses.size(), order == 2 ? (size_t) xs.cols() : 0u);
+
+        for (long i = 0; i < xs.cols(); i++) {
+            auto valueGradHess = func.valueGradHess(xs.col(i));
+            ASSERT_LE(abs(batch.values(i) - get<0>(valueGradHess)), eps);
+            if (order >= 1)
+                ASSERT_LE((batch.grads.col(i) - get<1>(valueGradHess)).norm(), eps);
+            if (order == 2)
+                ASSERT_LE((batch.hesses[i] - get<2>(valueGradHess)).norm(), eps);
+        }
+    }
+}
+
+TEST(FunctionProducer, EvaluateBatch)
+{
+    auto normalized = makeNormalizedEthylene();
+    auto polar = makePolar(normalized, .3);
+    auto sum = 2. * polar - polar + polar;
+
+    matrix xs = makeRandomMatrix(normalized.nDims, 7);
+    testBatch(normalized, xs, 1e-9);
+    testBatch(sum, xs.topRows(polar.nDims), 1e-9);
+
+    GaussianProducer water({8, 1, 1});
+    matrix waters(9, 3);
+    waters << makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.), makeVect(0., 0., 0., .97, 0., 0., -.25, .92, 0.),
+              makeVect(0., 0., 0., .95, 0., 0., -.23, .94, 0.);
+    auto batch = water.evaluateBatch(waters, 1);
+    ASSERT_EQ(water.getJobTimings().count(FORCE_METHOD, 1), 3u);
+    testBatch(water, waters, 1e-9);
+}
+
+TEST(FunctionProducer, OnSphereHessVecReusesGradient)
+{
+    struct Counted : public SqrNorm
+    {
+        Counted(size_t nDims, shared_ptr<size_t> calls) : SqrNorm(nDims), calls(move(calls))
+        { }
+
+        vect grad(vect const& x) override
+        {
+            ++*calls;
+            return SqrNorm::grad(x);
+        }
+
+        shared_ptr<size_t> calls;
+    };
+
+    auto calls = make_shared<size_t>(0);
+    auto onSphere = makeOnSphere(Counted(4, calls), .5, makeRandomVect(4));
+    auto zero = makeConstantVect(onSphere.nDims, 0.);
+    auto v = makeRandomVect(onSphere.nDims);
+
+    Evaluation evaluation;
+    onSphere.evaluateInto(zero, 1, evaluation);
+    auto product = onSphere.hessVec(zero, v);
+    onSphere.hessVec(zero, v);
+    ASSERT_EQ(*calls, 0u);
+    ASSERT_LE((product - onSphere.hess(zero) * v).norm(), 1e-9);
+
+    auto y = makeRandomVect(onSphere.nDims) * .1;
+    onSphere.hessVec(y, v);
+    onSphere.hessVec(y, v);
+    ASSERT_EQ(*calls, 1u);
+}
+
+TEST(FunctionProducer, SharedLeaves)
+{
+    struct Counted : public SqrNorm
+    {
+        Counted(size_t nDims, shared_ptr<size_t> calls) : SqrNorm(nDims), calls(move(calls))
+        { }
+
+        tuple<double, vect, matrix> valueGradHess(vect const& x) override
+        {
+            ++*calls;
+            return SqrNorm::valueGradHess(x);
+        }
+
+        shared_ptr<size_t> calls;
+    };
+
+    auto calls = make_shared<size_t>(0);
+    auto func = Counted(3, calls);
+    auto supplement = Counted(3, make_shared<size_t>(0));
+    auto withSupplement = func + supplement;
+
+    double alpha = .3;
+    auto linearComb = alpha * func + (1 - alpha) * withSupplement;
+    ASSERT_EQ(linearTerms(linearComb).size(), 2u);
+
+    auto x = makeRandomVect(3);
+    auto valueGradHess = linearComb.valueGradHess(x);
+    ASSERT_EQ(*calls, 1u);
+    ASSERT_EQ(*supplement.calls, 1u);
+
+    ASSERT_LE(abs(get<0>(valueGradHess) - (func(x) + (1 - alpha) * supplement(x))), 1e-12);
+    ASSERT_LE((get<2>(valueGradHess) - (func.hess(x) + (1 - alpha) * supplement.hess(x))).norm(), 1e-12);
+
+    auto difference = func - func;
+    ASSERT_EQ(linearTerms(difference).size(), 1u);
+    ASSERT_EQ(difference(x), 0.);
+
+    GaussianProducer molecule({8, 1, 1});
+    auto copy = molecule;
+    auto withCopy = molecule + copy;
+    ASSERT_EQ(linearTerms(withCopy).size(), 1u);
+
+    auto reconfigured = molecule;
+    reconfigured.setHessianMode(GaussianProducer::HessianMode::FiniteDifference);
+    auto withReconfigured = molecule + reconfigured;
+    ASSERT_EQ(linearTerms(withReconfigured).size(), 2u);
+
+    auto reused = molecule;
+    reused.setHessianReuse(make_shared<HessianHistory>());
+    auto withReused = molecule + reused;
+    ASSERT_EQ(linearTerms(withReused).size(), 2u);
+
+    auto billed = molecule;
+    billed.setUsage(make_shared<BackendUsage>());
+    auto withBilled = molecule + billed;
+    ASSERT_EQ(linearTerms(withBilled).size(), 2u);
+}
+
+template<typename FuncT>
+void testEvaluate(FuncT& func, vect const& x, double eps)
+{
+    auto valueGradHess = func.valueGradHess(x);
+    for (size_t order = 0; order <= 2; order++) {
+        auto evaluation = func.evaluate(x, order);
+        ASSERT_LE(abs(evaluation.value - get<0>(valueGradHess)), eps);
+        if (order >= 1)
+            ASSERT_LE((evaluation.grad - get<1>(valueGradHess)).norm(), eps);
+        if (order == 2)
+            ASSERT_LE((evaluation.hess - get<2>(valueGradHess)).norm(), eps);
+    }
+}
+
+TEST(FunctionProducer, Evaluate)
+{
+    auto normalized = makeNormalizedEthylene();
+    auto polar = makePolar(normalized, .3);
+    auto onSphere = makeOnSphere(normalized, .3, makeRandomVect(normalized.nDims));
+    auto sum = 2. * polar - polar + polar;
+
+    testEvaluate(normalized, makeRandomVect(normalized.nDims), 1e-9);
+    testEvaluate(polar, makeRandomVect(polar.nDims), 1e-9);
+    testEvaluate(onSphere, makeRandomVect(onSphere.nDims) * .1, 1e-9);
+    testEvaluate(sum, makeRandomVect(sum.nDims), 1e-9);
+
+    GaussianProducer water({8, 1, 1});
+    auto affine = makeAffineTransfomation(water, makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.));
+    affine.evaluate(makeConstantVect(affine.nDims, 0.), 2);
+    ASSERT_EQ(water.getJobTimings().count(HESS_METHOD, 1), 1u);
+    ASSERT_EQ(water.getJobTimings().count(SCF_METHOD, 1) + water.getJobTimings().count(FORCE_METHOD, 1), 0u);
+}
+
+template<typename FuncT>
+void testEvaluateIntoWithoutMalloc(FuncT& func, vect const& x)
+{
+    Evaluation evaluation;
+    func.evaluateInto(x, 2, evaluation);
+
+    Eigen::internal::set_is_malloc_allowed(false);
+    for (size_t iter = 0; iter < 10; iter++)
+        for (size_t order = 0; order <= 2; order++)
+            func.evaluateInto(x, order, evaluation);
+    Eigen::internal::set_is_malloc_allowed(true);
+
+    auto valueGradHess = func.valueGradHess(x);
+    ASSERT_LE(abs(evaluation.value - get<0>(valueGradHess)), 1e-9);
+    ASSERT_LE((evaluation.grad - get<1>(valueGradHess)).norm(), 1e-9);
+    ASSERT_LE((evaluation.hess - get<2>(valueGradHess)).norm(), 1e-9);
+}
+
+TEST(FunctionProducer, EvaluateIntoWithoutMalloc)
+{
+    matrix a = makeRandomMatrix(9, 9);
+    SecondOrderFunction quadratic(1., makeRandomVect(9), a.transpose() * a);
+
+    auto fixed = fixAtomTranslations(quadratic);
+    auto affine = makeAffineTransfomation(quadratic, makeRandomVect(9), makeRandomMatrix(9, 9));
+    auto polar = makePolarWithDirection(quadratic, .3, makeRandomVect(9));
+    auto onSphere = makeOnSphere(fixed, .3, makeRandomVect(fixed.nDims));
+    auto sum = onSphere + 2. * OnSphereCosineSupplement(makeRandomVect(onSphere.nDims), 1.) - .5 * onSphere;
+
+    testEvaluateIntoWithoutMalloc(fixed, makeRandomVect(fixed.nDims));
+    testEvaluateIntoWithoutMalloc(affine, makeRandomVect(affine.nDims));
+    testEvaluateIntoWithoutMalloc(polar, makeRandomVect(polar.nDims));
+    testEvaluateIntoWithoutMalloc(onSphere, makeRandomVect(onSphere.nDims) * .1);
+    testEvaluateIntoWithoutMalloc(sum, makeRandomVect(sum.nDims) * .1);
+}
+
+TEST(FunctionProducer, OptimizerIterationWithoutMalloc)
+{
+    matrix a = makeRandomMatrix(9, 9);
+    SecondOrderFunction quadratic(1., makeRandomVect(9), a.transpose() * a);
+    auto shared = share(fixAtomTranslations(quadratic));
+
+    double const r = .3;
+    vect p = makeRandomVect(shared.nDims);
+    p *= r / p.norm();
+
+    auto onSphere = makeOnSphere(shared, r, p);
+    vect momentum, step;
+    Evaluation evaluation;
+    optimization::momentumStepOnSphere(onSphere, r, p, momentum, step, evaluation, true);
+
+    Eigen::internal::set_is_malloc_allowed(false);
+    for (size_t iter = 0; iter < 10; iter++)
+        optimization::momentumStepOnSphere(onSphere, r, p, momentum, step, evaluation, false);
+    Eigen::internal::set_is_malloc_allowed(true);
+
+    ASSERT_LE(abs(p.norm() - r), 1e-12);
+
+    auto moved = makeOnSphere(shared, r, p);
+    onSphere.recenter(p);
+    vect y = makeRandomVect(moved.nDims) * .1;
+    ASSERT_LE((onSphere.transform(y) - moved.transform(y)).norm(), 1e-12);
+    ASSERT_LE((onSphere.evaluate(y, 2).hess - moved.evaluate(y, 2).hess).norm(), 1e-9);
+}
+
+TEST(FunctionProducer, SharedProducer)
+{
+    matrix a = makeRandomMatrix(9, 9);
+    SecondOrderFunction quadratic(1., makeRandomVect(9), a.transpose() * a);
+    auto affine = makeAffineTransfomation(quadratic, makeRandomVect(9), makeRandomMatrix(9, 9));
+
+    auto shared = share(affine);
+    Eigen::internal::set_is_malloc_allowed(false);
+    auto copy = shared;
+    auto again = share(copy);
+    Eigen::internal::set_is_malloc_allowed(true);
+    ASSERT_EQ(&again.getInnerFunction(), &shared.getInnerFunction());
+
+    auto direction = makeRandomVect(9);
+    auto onSphere = makeOnSphere(affine, .3, direction);
+    auto sharedOnSphere = makeOnSphere(copy, .3, direction);
+    testEvaluate(sharedOnSphere, makeRandomVect(sharedOnSphere.nDims) * .1, 1e-9);
+    vect y = makeRandomVect(onSphere.nDims) * .1;
+    ASSERT_LE((sharedOnSphere.evaluate(y, 2).hess - onSphere.evaluate(y, 2).hess).norm(), 1e-12);
+
+    auto sum = shared + again;
+    ASSERT_EQ(linearTerms(sum).size(), 1u);
+    ASSERT_LE(abs(sum(direction) - 2 * affine(direction)), 1e-9);
+}
+
+TEST(FunctionProducer, StaticallyKeepsOverrides)
+{
+    struct Doubled : public SqrNorm
+    {
+        using SqrNorm::SqrNorm;
+
+        vect grad(vect const& x) override
+        {
+            return 2 * SqrNorm::grad(x);
+        }
+    };
+
+    static_assert(is_final<AffineTransformation<SqrNorm>>::value, "layers are not qualified by statically");
+    static_assert(!is_final<SqrNorm>::value, "SqrNorm is derived from by the tests");
+
+    auto doubled = make_shared<Doubled>(3);
+    SqrNorm& base = *doubled;
+    auto x = makeRandomVect(3);
+    ASSERT_LE((statically(base).grad(x) - 4 * x).norm(), 1e-12);
+
+    auto shared = SharedProducer<SqrNorm>(doubled);
+    ASSERT_LE((shared.grad(x) - 4 * x).norm(), 1e-12);
+    auto affine = makeAffineTransfomation(shared, makeConstantVect(3, 0.));
+    ASSERT_LE((affine.grad(x) - 4 * x).norm(), 1e-12);
+}
+
 TEST(FunctionProducer, FixValues)
 {
     auto lowerBound = makeConstantVect(3, .9);
@@ -191,6 +672,66 @@ TEST(FunctionProducer, Stack2)
     testProducer(polar, lowerBound, upperBound, 1, 1e-3, 1e-3);
 }
 
+TEST(FunctionProducer, FusedStack)
+{
+    MorseMolecule molecule({6, 6, 1, 1, 1, 1});
+    auto structure = makeEthylene();
+    matrix shuffle = makeRandomMatrix(molecule.nDims, molecule.nDims) + identity(molecule.nDims);
+
+    auto shifted = AffineTransformation<MorseMolecule>(molecule, structure, shuffle);
+    auto fixedLayers = FixValues<decltype(shifted)>(shifted, {0, 1, 2, 4, 5, 8}, {0., .1, 0., 0., -.1, 0.});
+    auto normalizedLayers = AffineTransformation<decltype(fixedLayers)>(fixedLayers, makeRandomVect(fixedLayers.nDims),
+                                                                        makeRandomMatrix(fixedLayers.nDims, 10));
+    auto polarLayers = AffineTransformation<decltype(normalizedLayers), HouseholderRotation>(
+       normalizedLayers, makeConstantVect(10, 0.), HouseholderRotation(eye(10, 9), makeRandomVect(10)));
+
+    auto fixed = fix(makeAffineTransfomation(molecule, structure, shuffle), {0, 1, 2, 4, 5, 8},
+                     {0., .1, 0., 0., -.1, 0.});
+    auto normalized = makeAffineTransfomation(fixed, normalizedLayers.getDelta(), normalizedLayers.getBasis());
+    auto polar = makeAffineTransfomation(normalized, polarLayers.getBasis());
+    static_assert(is_same<decay_t<decltype(normalized.getFused())>, AffineTransformation<MorseMolecule>>::value,
+                  "stack is not collapsed");
+    static_assert(is_same<decltype(polar), AffineTransformation<decltype(normalized), HouseholderRotation>>::value,
+                  "rotation is not kept as a layer of its own");
+
+    for (size_t i = 0; i < 5; i++) {
+        vect x = makeRandomVect(polar.nDims) * .1;
+        ASSERT_LE((polar.fullTransform(x) - polarLayers.fullTransform(x)).norm(), 1e-12);
+        ASSERT_LE((polar.grad(x) - polarLayers.grad(x)).norm(), 1e-9);
+        ASSERT_LE((polar.hess(x) - polarLayers.hess(x)).norm(), 1e-9);
+        ASSERT_LE((polar.backTransform(polar.transform(x)) - x).norm(), 1e-9);
+
+        //accessors of a fused layer answer in the coordinates of the layer it was built over
+        vect y = polar.transform(x);
+        ASSERT_LE((normalized.transform(y) - normalizedLayers.transform(y)).norm(), 1e-12);
+        ASSERT_LE((normalized.backTransform(normalized.transform(y)) - y).norm(), 1e-9);
+        vect z = normalized.transform(y);
+        ASSERT_LE((fixed.transform(z) - fixedLayers.transform(z)).norm(), 1e-12);
+        ASSERT_LE((fixed.backTransform(fixed.transform(z)) - z).norm(), 1e-12);
+    }
+    ASSERT_TRUE(normalized.getBasis().isApprox(normalizedLayers.getBasis()));
+    ASSERT_TRUE(fixed.getInnerFunction().getDelta().isApprox(structure));
+
+    matrix A = makeRandomMatrix(molecule.nDims, molecule.nDims);
+    matrix B = makeRandomMatrix(molecule.nDims, 8);
+    auto inner = makeAffineTransfomation(molecule, A);
+    auto composed = makeAffineTransfomation(inner, B);
+    auto composedLayers = AffineTransformation<decltype(inner)>(inner, makeConstantVect(molecule.nDims, 0.), B);
+    vect x = makeRandomVect(composed.nDims);
+    ASSERT_LE((composed.transform(x) - composedLayers.transform(x)).norm(), 1e-12);
+    ASSERT_LE((composed.fullTransform(x) - composedLayers.fullTransform(x)).norm(), 1e-12);
+
+    auto twiceFixed = fix(fixAtomSymmetry(molecule), {1, 3}, {.2, -.3});
+    static_assert(is_same<decay_t<decltype(twiceFixed.getFused())>, FixValues<MorseMolecule>>::value,
+                  "fixes are not merged");
+    auto twiceFixedLayers = FixValues<decltype(fixAtomSymmetry(molecule))>(fixAtomSymmetry(molecule), {1, 3}, {.2, -.3});
+
+    x = makeRandomVect(twiceFixed.nDims);
+    ASSERT_LE((twiceFixed.fullTransform(x) - twiceFixedLayers.fullTransform(x)).norm(), 1e-15);
+    ASSERT_LE((twiceFixed.transform(x) - twiceFixedLayers.transform(x)).norm(), 1e-15);
+    ASSERT_LE((twiceFixed.hess(x) - twiceFixedLayers.hess(x)).norm(), 1e-12);
+}
+
 TEST(FunctionProducer, Stack3)
 {
     ifstream input("./C2H4");
@@ -372,3 +913,561 @@ TEST(FunctionProducer, SecondOrderFunction)
 }
 
 
+
+TEST(EvaluationCache, HigherOrderAnswersLower)
+{
+    EvaluationCache cache;
+    auto x = makeRandomVect(9);
+
+    size_t computations = 0;
+    auto compute = [&](size_t order) {
+        computations++;
+        GaussianResult result;
+        result.value = x.sum();
+        if (order >= 1)
+            result.grad = x;
+        if (order >= 2)
+            result.hess = x * x.transpose();
+        return result;
+    };
+
+    cache.get(x, 2, [&] { return compute(2); });
+    ASSERT_TRUE((bool) cache.get(x, 1, [&] { return compute(1); }).grad);
+    cache.get(x, 0, [&] { return compute(0); });
+    cache.get(x + makeConstantVect(9, 1e-3), 0, [&] { return compute(0); });
+
+    ASSERT_EQ(computations, 2u);
+    ASSERT_EQ(cache.hits(), 2u);
+    ASSERT_EQ(cache.misses(), 2u);
+}
+
+TEST(EvaluationCache, ConcurrentRequestsAreCoalesced)
+{
+    EvaluationCache cache;
+    auto x = makeRandomVect(9);
+
+    atomic<size_t> computations(0);
+
+    #pragma omp parallel for num_threads(8)
+    for (size_t i = 0; i < 8; i++) {
+        auto result = cache.get(x, 1, [&] {
+            computations++;
+            this_thread::sleep_for(chrono::milliseconds(200));
+
+            GaussianResult result;
+            result.value = 1.;
+            result.grad = x;
+            return result;
+        });
+        assert(result.value == 1.);
+    }
+
+    ASSERT_EQ(computations.load(), 1u);
+    ASSERT_EQ(cache.misses(), 1u);
+    ASSERT_EQ(cache.hits() + cache.coalesced(), 7u);
+}
+
+TEST(ResultStore, SharedBetweenInstances)
+{
+    string const path = "./tmp_result_store";
+    remove(path.c_str());
+
+    vector<size_t> charges = {8, 1, 1};
+    auto x = makeRandomVect(9);
+
+    GaussianResult result;
+    result.value = -76.;
+    result.grad = makeRandomVect(9);
+    matrix hess = makeRandomMatrix(9, 9);
+    result.hess = matrix(hess + hess.transpose());
+
+    {
+        ResultStore writer(path);
+        writer.append(charges, x, 2, LEVEL_OF_THEORY, result);
+    }
+
+    ResultStore reader(path);
+    ResultStore writer(path);
+
+    ASSERT_FALSE((bool) reader.find(charges, x + makeConstantVect(9, 1e-3), 0, LEVEL_OF_THEORY));
+    ASSERT_FALSE((bool) reader.find({8, 1, 2}, x, 0, LEVEL_OF_THEORY));
+    ASSERT_FALSE((bool) reader.find(charges, x, 0, "HF/sto-3g"));
+
+    auto stored = reader.find(charges, x, 1, LEVEL_OF_THEORY);
+    ASSERT_TRUE((bool) stored);
+    ASSERT_EQ(stored->value, result.value);
+    ASSERT_LE((*stored->grad - *result.grad).norm(), 1e-15);
+    ASSERT_LE((*stored->hess - *result.hess).norm(), 1e-15);
+
+    writer.append(charges, 2 * x, 0, LEVEL_OF_THEORY, result);
+    ASSERT_TRUE((bool) reader.find(charges, 2 * x, 0, LEVEL_OF_THEORY));
+    ASSERT_FALSE((bool) reader.find(charges, 2 * x, 1, LEVEL_OF_THEORY));
+    ASSERT_EQ(reader.size(), 2u);
+
+    remove(path.c_str());
+}
+
+TEST(ResultStore, AppendAfterTornRecord)
+{
+    string const path = "./tmp_result_store_torn";
+    string const tornPath = "./tmp_result_store_torn_source";
+    remove(path.c_str());
+    remove(tornPath.c_str());
+
+    vector<size_t> charges = {8, 1, 1};
+    auto x = makeRandomVect(9);
+
+    GaussianResult result;
+    result.value = -76.;
+    result.grad = makeRandomVect(9);
+
+    {
+        ResultStore source(tornPath);
+        source.append(charges, 3 * x, 1, LEVEL_OF_THEORY, result);
+    }
+    ifstream tornInput(tornPath, ios::binary);
+    string record((istreambuf_iterator<char>(tornInput)), istreambuf_iterator<char>());
+
+    ResultStore writer(path);
+    ResultStore reader(path);
+    writer.append(charges, x, 1, LEVEL_OF_THEORY, result);
+    {
+        //what a writer killed in the middle of its write leaves behind
+        ofstream output(path, ios::binary | ios::app);
+        output.write(record.data(), record.size() / 2 + 3);
+    }
+    ASSERT_EQ(reader.size(), 1u);
+
+    writer.append(charges, 2 * x, 1, LEVEL_OF_THEORY, result);
+    ASSERT_TRUE((bool) reader.find(charges, 2 * x, 1, LEVEL_OF_THEORY));
+    ASSERT_FALSE((bool) reader.find(charges, 3 * x, 0, LEVEL_OF_THEORY));
+    ASSERT_EQ(reader.size(), 2u);
+    ASSERT_EQ(ResultStore(path).size(), 2u);
+
+    remove(path.c_str());
+    remove(tornPath.c_str());
+}
+
+TEST(ResultStore, FileShrunkByAnotherWriter)
+{
+    string const path = "./tmp_result_store_shrunk";
+    remove(path.c_str());
+
+    vector<size_t> charges = {8, 1, 1};
+    auto x = makeRandomVect(9);
+
+    GaussianResult result;
+    result.value = -76.;
+    result.grad = makeRandomVect(9);
+
+    ResultStore writer(path);
+    ResultStore reader(path);
+    writer.append(charges, x, 1, LEVEL_OF_THEORY, result);
+    size_t recordSize = (size_t) ifstream(path, ios::binary | ios::ate).tellg();
+    {
+        //a partial record that another writer's failed append has not truncated away yet
+        ofstream output(path, ios::binary | ios::app);
+        output << string(3 * recordSize, 'x');
+    }
+    ASSERT_EQ(reader.size(), 1u);
+
+    ASSERT_EQ(truncate(path.c_str(), recordSize), 0);
+    ASSERT_EQ(reader.size(), 1u);
+    ASSERT_TRUE((bool) reader.find(charges, x, 1, LEVEL_OF_THEORY));
+
+    ASSERT_EQ(truncate(path.c_str(), recordSize / 2), 0);
+    ASSERT_EQ(reader.size(), 0u);
+    ASSERT_FALSE((bool) reader.find(charges, x, 0, LEVEL_OF_THEORY));
+
+    ASSERT_EQ(truncate(path.c_str(), 0), 0);
+    writer.append(charges, 2 * x, 1, LEVEL_OF_THEORY, result);
+    ASSERT_TRUE((bool) reader.find(charges, 2 * x, 1, LEVEL_OF_THEORY));
+    ASSERT_EQ(reader.size(), 1u);
+
+    remove(path.c_str());
+}
+
+TEST(JobPool, CoreBudget)
+{
+    JobPool pool(4, 8);
+
+    mutex guard;
+    size_t busyCores = 0;
+    size_t maxBusyCores = 0;
+
+    vector<future<size_t>> results;
+    for (size_t i = 0; i < 16; i++) {
+        size_t cores = i % 3 + 1;
+        results.push_back(pool.submit(cores, [&, cores, i] {
+            {
+                lock_guard<mutex> lock(guard);
+                busyCores += cores;
+                maxBusyCores = max(maxBusyCores, busyCores);
+            }
+            this_thread::sleep_for(chrono::milliseconds(20));
+            {
+                lock_guard<mutex> lock(guard);
+                busyCores -= cores;
+            }
+            return i;
+        }));
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+        ASSERT_EQ(results[i].get(), i);
+    ASSERT_LE(maxBusyCores, 4u);
+    ASSERT_GE(maxBusyCores, 2u);
+}
+
+TEST(JobPool, NestedJobsRunWhileWaiting)
+{
+    JobPool pool(2);
+
+    vector<future<size_t>> outer;
+    for (size_t i = 0; i < 2; i++)
+        outer.push_back(pool.submit(1, [&pool, i] {
+            vector<future<size_t>> inner;
+            for (size_t j = 0; j < 8; j++)
+                inner.push_back(pool.submit(1, [i, j] { return i * j; }));
+
+            size_t sum = 0;
+            for (auto& result : inner)
+                sum += pool.await(result);
+            return sum;
+        }));
+
+    ASSERT_EQ(pool.await(outer[0]), 0u);
+    ASSERT_EQ(pool.await(outer[1]), 28u);
+}
+
+TEST(ScratchManager, UniqueRecycledDirectories)
+{
+    auto scratch = make_shared<ScratchManager>("./tmp", 2);
+
+    set<string> paths;
+    {
+        vector<ScratchManager::Lease> leases;
+        for (size_t i = 0; i < 4; i++) {
+            leases.push_back(scratch->acquire());
+            ofstream(leases.back().getPath() + "rwf") << string(10000, 'x');
+            ASSERT_GE(leases.back().usage(), 10000u);
+            paths.insert(leases.back().getPath());
+        }
+    }
+    ASSERT_EQ(paths.size(), 4u);
+
+    while (scratch->getIdleDirectories() < 2)
+        this_thread::yield();
+
+    auto usage = scratch->getUsage();
+    ASSERT_EQ(usage.jobs, 4u);
+    ASSERT_GE(usage.peakBytes, 10000u);
+
+    auto lease = scratch->acquire();
+    ASSERT_EQ(paths.count(lease.getPath()), 1u);
+    ASSERT_EQ(lease.usage(), 0u);
+
+    scratch.reset();
+    ofstream(lease.getPath() + "rwf") << "outlives the last other owner";
+    ASSERT_GT(lease.usage(), 0u);
+}
+
+TEST(ProcessLauncher, ExitCodesTimeoutsAndCancellation)
+{
+    ProcessLauncher launcher;
+
+    auto result = launcher.run({"sh", "-c", "echo $VALUE >&2; exit 3"}, "./tmp", {{"VALUE", "oops"}}, "./tmp/stderr");
+    ASSERT_EQ(result.status, ProcessResult::Status::Exited);
+    ASSERT_EQ(result.code, 3);
+    ASSERT_EQ(result.stderrTail, "oops\n");
+
+    ASSERT_TRUE(launcher.run({"true"}, ".").succeeded());
+    ASSERT_THROW(launcher.run({"./definitely-missing-binary"}, "."), runtime_error);
+
+    ProcessLimits limits;
+    limits.timeout = .2;
+    launcher.setLimits(limits);
+    result = launcher.run({"sleep", "10"}, ".");
+    ASSERT_EQ(result.status, ProcessResult::Status::TimedOut);
+    ASSERT_LT(result.wallTime, 5.);
+
+    //the limits are already there when the program starts
+    limits = ProcessLimits();
+    limits.cpuSeconds = 7;
+    limits.memoryBytes = 1ul << 32;
+    launcher.setLimits(limits);
+    result = launcher.run({"sh", "-c", "echo $(ulimit -t) $(ulimit -v) >&2"}, ".", {}, "./tmp/stderr");
+    ASSERT_TRUE(result.succeeded());
+    ifstream limitsOutput("./tmp/stderr");
+    string cpuLimit, memoryLimit;
+    limitsOutput >> cpuLimit >> memoryLimit;
+    ASSERT_EQ(cpuLimit, "7");
+    ASSERT_EQ(memoryLimit, to_string((1ul << 32) / 1024));
+
+    launcher.setLimits(ProcessLimits());
+    thread canceller([&] {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        launcher.cancelAll();
+    });
+    result = launcher.run({"sleep", "10"}, ".");
+    canceller.join();
+    ASSERT_EQ(result.status, ProcessResult::Status::Cancelled);
+
+    //a handle cancels its own launch and leaves the others running
+    auto first = make_shared<ProcessHandle>();
+    auto second = make_shared<ProcessHandle>();
+    atomic<bool> secondDone(false);
+    ProcessResult secondResult;
+    thread secondLauncher([&] {
+        secondResult = launcher.run({"sleep", "10"}, ".", {}, "/dev/null", second);
+        secondDone = true;
+    });
+    thread firstCanceller([&] {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        first->cancel();
+    });
+    result = launcher.run({"sleep", "10"}, ".", {}, "/dev/null", first);
+    firstCanceller.join();
+    ASSERT_EQ(result.status, ProcessResult::Status::Cancelled);
+    ASSERT_LT(result.wallTime, 5.);
+    ASSERT_FALSE(secondDone);
+
+    second->cancel();
+    secondLauncher.join();
+    ASSERT_EQ(secondResult.status, ProcessResult::Status::Cancelled);
+
+    auto early = make_shared<ProcessHandle>();
+    early->cancel();
+    ASSERT_EQ(launcher.run({"sleep", "10"}, ".", {}, "/dev/null", early).status, ProcessResult::Status::Cancelled);
+}
+
+TEST(CheckpointHistory, NearestRetainedCheckpoint)
+{
+    auto scratch = make_shared<ScratchManager>("./tmp");
+    CheckpointHistory history(scratch->acquire(), 2, 1.);
+
+    vector<vect> structures;
+    for (size_t i = 0; i < 3; i++) {
+        auto job = scratch->acquire();
+        ofstream(job.getPath() + "chk.chk") << "checkpoint " << i;
+        structures.push_back(makeConstantVect(6, i));
+        history.add(structures.back(), job.getPath() + "chk.chk");
+    }
+    ASSERT_EQ(history.size(), 2u);
+
+    history.add(makeConstantVect(6, 3.), scratch->acquire().getPath() + "chk.chk");
+    ASSERT_EQ(history.size(), 2u);
+
+    ASSERT_FALSE(history.nearest(makeConstantVect(6, -1.)));
+    ASSERT_FALSE(history.nearest(makeConstantVect(3, 2.)));
+
+    auto checkpoint = history.nearest(makeConstantVect(6, 1.9));
+    ASSERT_TRUE(checkpoint);
+    ASSERT_TRUE(checkpoint->getStructure().isApprox(structures[2]));
+    ASSERT_EQ(history.getWarmStarts(), 1u);
+
+    auto job = scratch->acquire();
+    ASSERT_TRUE(checkpoint->copyTo(job.getPath() + "chk.chk"));
+    string content;
+    getline(ifstream(job.getPath() + "chk.chk"), content);
+    ASSERT_EQ(content, "checkpoint 2");
+}
+
+TEST(HessianHistory, UpdatesNearbyHessians)
+{
+    auto gradAt = [](vect const& x) {
+        vect grad(2);
+        grad << 4 * x(0) * x(0) * x(0) + x(1), x(0) + 2 * x(1);
+        return grad;
+    };
+    auto hessAt = [](vect const& x) {
+        matrix hess(2, 2);
+        hess << 12 * x(0) * x(0), 1, 1, 2;
+        return hess;
+    };
+
+    HessianHistory history(HessianHistory::Update::Bofill, .3, .5, 2);
+
+    vect x0 = makeConstantVect(2, 1.);
+    ASSERT_FALSE(history.nearest(x0));
+    history.add({x0, gradAt(x0), hessAt(x0), 0});
+
+    vect x1 = x0 + makeConstantVect(2, .05);
+    auto base = history.nearest(x1);
+    ASSERT_TRUE(base);
+    auto hess = history.update(*base, x1, gradAt(x1));
+    ASSERT_TRUE(hess);
+    ASSERT_TRUE((*hess * (x1 - x0)).isApprox(gradAt(x1) - gradAt(x0)));
+    ASSERT_LT((*hess - hessAt(x1)).norm(), (hessAt(x0) - hessAt(x1)).norm());
+    history.add({x1, gradAt(x1), *hess, 1});
+
+    ASSERT_FALSE(history.nearest(x0 + makeConstantVect(2, 1.)));
+    ASSERT_FALSE(history.update(*base, x1, gradAt(x1) + makeConstantVect(2, 10.)));
+    ASSERT_FALSE(history.update(HessianHistory::Entry{x1, gradAt(x1), *hess, 2}, x0, gradAt(x0)));
+
+    ASSERT_EQ(history.getExactHessians(), 1u);
+    ASSERT_EQ(history.getUpdatedHessians(), 1u);
+}
+
+TEST(HessianHistory, ReuseOnlyInsideScope)
+{
+    GaussianProducer molecule({8, 1, 1});
+    //any update is accepted, so only the scope decides
+    molecule.setHessianReuse(make_shared<HessianHistory>(HessianHistory::Update::Bofill, .3, 1e9));
+    auto const& timings = molecule.getJobTimings();
+    auto x = makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.);
+    vect shift = .01 * eye(9, 3);
+
+    molecule.hess(x);
+    molecule.hess(x + shift);
+    ASSERT_EQ(timings.count(HESS_METHOD, 1), 2u);
+
+    {
+        HessianReuseScope reuse;
+        molecule.hess(x + 2 * shift);
+    }
+    ASSERT_EQ(timings.count(HESS_METHOD, 1), 2u);
+    ASSERT_EQ(molecule.getHessianHistory()->getUpdatedHessians(), 1u);
+
+    //a saddle point check after a second-order loop, as in tryToOptimizeTS
+    auto fixed = remove6LesserHessValues2(molecule, x + 3 * shift);
+    singularValues(fixed.hess(makeConstantVect(fixed.nDims, 0)));
+    ASSERT_EQ(timings.count(HESS_METHOD, 1), 3u);
+    ASSERT_EQ(molecule.getHessianHistory()->getUpdatedHessians(), 1u);
+}
+
+TEST(BackendUsage, StagesHitsAndJson)
+{
+    auto usage = make_shared<BackendUsage>();
+    GaussianProducer molecule({8, 1, 1});
+    molecule.setUsage(usage);
+    auto x = makeVect(0., 0., 0., .96, 0., 0., -.24, .93, 0.);
+
+    {
+        UsageStage stage("first");
+        molecule.grad(x);
+        molecule(x);
+
+        UsageStage nested("second");
+        auto job = molecule.submit(x + makeConstantVect(9, .01), SCF_METHOD);
+        ASSERT_EQ(UsageStage::current(), "second");
+        job.get();
+    }
+    ASSERT_EQ(UsageStage::current(), "unstaged");
+
+    auto first = usage->get("first", FORCE_METHOD);
+    ASSERT_EQ(first.jobs, 1u);
+    ASSERT_GT(first.wallSeconds, 0.);
+    ASSERT_EQ(accumulate(first.histogram.begin(), first.histogram.end(), (size_t) 0), 1u);
+    ASSERT_EQ(usage->get("first", SCF_METHOD).cacheHits, 1u);
+    ASSERT_EQ(usage->get("second", SCF_METHOD).jobs, 1u);
+    ASSERT_EQ(usage->get("second", FORCE_METHOD).jobs, 0u);
+
+    usage->recordJob("first", HESS_METHOD, 3., 6.);
+    ASSERT_EQ(usage->get("first", HESS_METHOD).histogram[4], 1u);
+
+    string const path = "./tmp_backend_usage.json";
+    usage->startPeriodicDump(path, 100);
+    usage->stopPeriodicDump();
+
+    ifstream input(path);
+    string json((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    ASSERT_EQ(json, usage->toJson());
+    ASSERT_NE(json.find("\"second\": {\n      \"scf\": {\"jobs\": 1,"), string::npos) << json;
+    remove(path.c_str());
+}
+
+TEST(FchkParser, FortranDouble)
+{
+    uniform_real_distribution<double> mantissa(-10., 10.);
+    uniform_int_distribution<int> exponent(-30, 30);
+
+    for (size_t i = 0; i < 10000; i++) {
+        auto text = format("{:22.15E}", mantissa(randomGen) * pow(10., exponent(randomGen)));
+        char const* p = text.data();
+
+        ASSERT_EQ(parseFortranDouble(p, text.data() + text.size()), strtod(text.c_str(), nullptr)) << text;
+        ASSERT_EQ(p, text.data() + text.size());
+    }
+
+    string text = "  -0.12345678D-03";
+    char const* p = text.data();
+    ASSERT_EQ(parseFortranDouble(p, text.data() + text.size()), -0.12345678e-3);
+}
+
+TEST(FchkParser, RoundTrip)
+{
+    size_t const nAtoms = 7;
+    size_t const nDims = nAtoms * 3;
+    string const path = "./tmp_test.fchk";
+
+    vector<size_t> charges(nAtoms, 6);
+    vect structure = makeRandomVect(nDims);
+
+    GaussianResult result;
+    result.value = -78.123456789012345;
+    result.grad = makeRandomVect(nDims);
+    matrix hess = makeRandomMatrix(nDims, nDims);
+    result.hess = matrix(hess + hess.transpose());
+
+    {
+        ofstream output(path);
+        writeFchk(output, "round trip", charges, structure, result);
+    }
+
+    auto parsed = parseFchk(path, nDims, 2, 2.);
+    ASSERT_LE(abs(parsed.value - result.value), 1e-13);
+    ASSERT_LE((*parsed.grad - 2. * *result.grad).norm(), 1e-7);
+    ASSERT_LE((*parsed.hess - 4. * *result.hess).norm(), 1e-6);
+    ASSERT_LE((parseFchkStructure(path, nDims, 2.) - structure / 2.).norm(), 1e-7);
+
+    auto valueOnly = parseFchk(path, nDims, 0, 1.);
+    ASSERT_FALSE((bool) valueOnly.grad);
+    ASSERT_ANY_THROW(parseFchk(path, nDims + 3, 1, 1.));
+
+    remove(path.c_str());
+}
+
+TEST(KrylovSolvers, Solvers)
+{
+    size_t const n = 30;
+
+    matrix a = makeRandomMatrix(n, n);
+    matrix positive = a * a.transpose() + matrix::Identity(n, n);
+    matrix indefinite = a + a.transpose();
+    vect b = makeRandomVect(n);
+
+    auto applyPositive = [&](vect const& v) -> vect { return positive * v; };
+    auto applyIndefinite = [&](vect const& v) -> vect { return indefinite * v; };
+
+    ASSERT_LE((positive * optimization::lanczosAbsoluteSolve(applyPositive, b, 1e-12) - b).norm(), 1e-6 * b.norm());
+
+    Eigen::SelfAdjointEigenSolver<matrix> solver(indefinite);
+    matrix absoluteInverse = solver.eigenvectors() * solver.eigenvalues().cwiseAbs().cwiseInverse().asDiagonal() *
+                             solver.eigenvectors().transpose();
+    vect absoluteSolution = absoluteInverse * b;
+    ASSERT_LE((optimization::lanczosAbsoluteSolve(applyIndefinite, b, 1e-12) - absoluteSolution).norm(),
+              1e-6 * absoluteSolution.norm());
+}
+
+TEST(FixedDimensions, KernelsMatchDynamic)
+{
+    for (size_t n : {5, MIN_FIXED_DIMS, 12, MAX_FIXED_DIMS, MAX_FIXED_DIMS + 5}) {
+        ASSERT_EQ(dispatchDimension(n, [](auto dims) { return decltype(dims)::value; }),
+                  n >= MIN_FIXED_DIMS && n <= MAX_FIXED_DIMS ? (int) n : Eigen::Dynamic);
+
+        matrix a = makeRandomMatrix(n, n);
+        matrix hess = a * a.transpose() + matrix::Identity(n, n);
+        vect grad = makeRandomVect(n);
+
+        ASSERT_LE((hess * newtonStep(hess, grad) + grad).norm(), 1e-9);
+
+        vect expected = Eigen::JacobiSVD<matrix>(hess).singularValues();
+        vect actual = singularValues(hess).transpose();
+        sort(actual.data(), actual.data() + n, greater<double>());
+        ASSERT_LE((actual - expected).norm(), 1e-9 * expected.norm());
+
+        matrix linear = linearization(hess);
+        ASSERT_LE((linear.transpose() * linear - matrix::Identity(n, n)).norm(), 1e-9);
+    }
+}
@@ -0,0 +1,216 @@
+#include "helper.h"
+
+#include <map>
+#include <thread>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+
+#include "producers/MorseMolecule.h"
+#include "producers/GaussianProducer.h"
+#include "gaussian/FchkParser.h"
+
+//stand-in for mg09D and formchk. It reads the input GaussianProducer writes, evaluates MorseMolecule on the atoms
+//and writes the checkpoint files a real run would leave behind. Configured through the environment:
+//  FAKE_GAUSSIAN_LATENCY      fixed:<seconds> | lognormal:<median seconds>:<sigma> | scaled:<scf seconds>
+//                             (scaled multiplies by 2 for force, 6 for freq and 10 for optimization)
+//  FAKE_GAUSSIAN_FAILURE_RATE probability of an error termination
+
+thread_local mt19937 randomGen(random_device{}());
+shared_ptr<spdlog::logger> logger;
+
+namespace
+{
+    struct Job
+    {
+        map<string, string> links;
+        vector<string> keywords;
+        vector<size_t> charges;
+        vector<double> coordinates;
+    };
+
+    double const WARM_START_FACTOR = .6;
+
+    string getEnv(char const* name)
+    {
+        char const* value = getenv(name);
+        return value ? value : "";
+    }
+
+    Job readJob(istream& input)
+    {
+        Job job;
+
+        string line;
+        while (getline(input, line) && !line.empty() && line[0] == '%') {
+            auto eq = line.find('=');
+            auto name = boost::to_lower_copy(line.substr(1, eq == string::npos ? string::npos : eq - 1));
+            job.links[name] = eq == string::npos ? "" : line.substr(eq + 1);
+        }
+
+        if (line.empty() || line[0] != '#')
+            throw runtime_error("route section expected");
+        boost::split(job.keywords, boost::to_lower_copy(line.substr(1)), boost::is_any_of(" \t"),
+                     boost::token_compress_on);
+
+        int charge, multiplicity;
+        while (getline(input, line))
+            if (istringstream(line) >> charge >> multiplicity)
+                break;
+
+        while (getline(input, line)) {
+            istringstream atom(line);
+            size_t atomCharge;
+            double x, y, z;
+            if (!(atom >> atomCharge >> x >> y >> z))
+                break;
+
+            job.charges.push_back(atomCharge);
+            job.coordinates.insert(job.coordinates.end(), {x, y, z});
+        }
+
+        if (job.charges.empty())
+            throw runtime_error("molecule specification expected");
+        return job;
+    }
+
+    bool hasKeyword(Job const& job, string const& keyword)
+    {
+        for (auto const& word : job.keywords)
+            if (word == keyword || boost::starts_with(word, keyword + "="))
+                return true;
+        return false;
+    }
+
+    //Gaussian and formchk add .chk to a checkpoint name without an extension
+    string checkpointPath(string const& name)
+    {
+        auto dot = name.rfind('.');
+        if (dot == string::npos || (name.rfind('/') != string::npos && dot < name.rfind('/')))
+            return name + ".chk";
+        return name;
+    }
+
+    string getMethod(Job const& job)
+    {
+        for (auto const& method : {HESS_METHOD, FORCE_METHOD, boost::to_lower_copy(OPT_METHOD)})
+            if (hasKeyword(job, method))
+                return method;
+        return SCF_METHOD;
+    }
+
+    double sampleLatency(string const& method, bool warmStart)
+    {
+        vector<string> spec;
+        auto latency = getEnv("FAKE_GAUSSIAN_LATENCY");
+        if (latency.empty())
+            return 0.;
+        boost::split(spec, latency, boost::is_any_of(":"));
+
+        double seconds;
+        if (spec[0] == "fixed" && spec.size() == 2)
+            seconds = stod(spec[1]);
+        else if (spec[0] == "lognormal" && spec.size() == 3)
+            seconds = lognormal_distribution<double>(log(stod(spec[1])), stod(spec[2]))(randomGen);
+        else if (spec[0] == "scaled" && spec.size() == 2) {
+            seconds = stod(spec[1]);
+            if (method == FORCE_METHOD)
+                seconds *= 2;
+            else if (method == HESS_METHOD)
+                seconds *= 6;
+            else if (method != SCF_METHOD)
+                seconds *= 10;
+        } else
+            throw runtime_error("bad FAKE_GAUSSIAN_LATENCY: " + latency);
+
+        return warmStart ? seconds * WARM_START_FACTOR : seconds;
+    }
+
+    int runGaussian(string const& inputPath, string const& outputPath)
+    {
+        ifstream input(inputPath);
+        if (!input) {
+            cerr << "cannot open " << inputPath << endl;
+            return 1;
+        }
+
+        auto job = readJob(input);
+        auto method = getMethod(job);
+        auto chkPath = job.links.count("chk") ? checkpointPath(job.links["chk"]) : "";
+        bool warmStart = hasKeyword(job, "guess") && !chkPath.empty() && ifstream(chkPath);
+
+        this_thread::sleep_for(chrono::duration<double>(sampleLatency(method, warmStart)));
+
+        auto failureRate = getEnv("FAKE_GAUSSIAN_FAILURE_RATE");
+        if (!failureRate.empty() && uniform_real_distribution<double>()(randomGen) < stod(failureRate)) {
+            ofstream(outputPath) << " Error termination via Lnk1e (injected failure)." << endl;
+            cerr << "injected failure" << endl;
+            return 1;
+        }
+
+        MorseMolecule molecule(job.charges);
+        vect structure = Eigen::Map<vect>(job.coordinates.data(), job.coordinates.size());
+
+        size_t order = methodOrder(method);
+        if (method != SCF_METHOD && !order)
+            structure = molecule.optimize(structure);
+
+        double const factor = GaussianProducer::MAGIC_CONSTANT;
+        GaussianResult result;
+        if (order == 2) {
+            auto valueGradHess = molecule.valueGradHess(structure);
+            result = GaussianResult{get<0>(valueGradHess), vect(get<1>(valueGradHess) / factor),
+                                    matrix(get<2>(valueGradHess) / (factor * factor))};
+        } else if (order == 1) {
+            auto valueGrad = molecule.valueGrad(structure);
+            result = GaussianResult{get<0>(valueGrad), vect(get<1>(valueGrad) / factor), boost::none};
+        } else
+            result = GaussianResult{molecule(structure), boost::none, boost::none};
+
+        ostringstream fchk;
+        writeFchk(fchk, "fake Gaussian " + method, job.charges, structure * factor, result);
+
+        if (!chkPath.empty())
+            ofstream(chkPath) << fchk.str();
+        if (hasKeyword(job, "formcheck"))
+            ofstream("Test.FChk") << fchk.str();
+
+        ofstream(outputPath) << format(" SCF Done:  E(RB3LYP) = {:.12f}\n Normal termination of fake Gaussian.\n",
+                                       result.value);
+        return 0;
+    }
+
+    int runFormchk(string const& chkPath, string const& fchkPath)
+    {
+        ifstream from(chkPath);
+        if (!from) {
+            cerr << "cannot open " << chkPath << endl;
+            return 1;
+        }
+        ofstream(fchkPath) << from.rdbuf();
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    string name = argv[0];
+    name = name.substr(name.rfind('/') + 1);
+
+    try {
+        if (name == "formchk") {
+            if (argc != 2 && argc != 3)
+                return 2;
+            string chkPath = checkpointPath(argv[1]);
+            return runFormchk(chkPath, argc == 3 ? argv[2] : chkPath.substr(0, chkPath.rfind('.')) + ".fchk");
+        }
+
+        if (argc < 2)
+            return 2;
+        string inputPath = argv[1];
+        string outputPath = argc > 2 ? argv[2] : inputPath.substr(0, inputPath.rfind('.')) + ".log";
+        return runGaussian(inputPath, outputPath);
+    } catch (exception const& exc) {
+        cerr << name << ": " << exc.what() << endl;
+        return 1;
+    }
+}